@@ -4,13 +4,244 @@
 #include "config.h"
 #include "stats.h"
 struct calculated_values calculated_values;
+uint32_t calculation_recomputes[NUM_CALC_NODES];
+
+/* Published copies of calculated_values. The low bit of the sequence selects
+ * the current buffer, and readers that may be interrupted by a publish retry
+ * if it changes during their copy */
+static struct calculated_values published_values[2];
+static volatile uint32_t published_sequence;
+
+#define CALC_INPUT_MASK(x) (1 << (x))
+#define ALL_CALC_NODES ((1 << NUM_CALC_NODES) - 1)
+
+/* Inputs each term depends on */
+static const uint32_t calculation_node_inputs[NUM_CALC_NODES] = {
+  [CALC_NODE_TIMING] = CALC_INPUT_MASK(CALC_INPUT_RPM) |
+                       CALC_INPUT_MASK(CALC_INPUT_MAP) |
+                       CALC_INPUT_MASK(CALC_INPUT_IAT),
+  [CALC_NODE_DWELL] =
+    CALC_INPUT_MASK(CALC_INPUT_RPM) | CALC_INPUT_MASK(CALC_INPUT_BRV),
+  [CALC_NODE_VE] = CALC_INPUT_MASK(CALC_INPUT_RPM) |
+                   CALC_INPUT_MASK(CALC_INPUT_MAP) |
+                   CALC_INPUT_MASK(CALC_INPUT_IAT),
+  [CALC_NODE_LAMBDA] = CALC_INPUT_MASK(CALC_INPUT_RPM) |
+                       CALC_INPUT_MASK(CALC_INPUT_MAP) |
+                       CALC_INPUT_MASK(CALC_INPUT_IAT),
+  [CALC_NODE_IDT] = CALC_INPUT_MASK(CALC_INPUT_BRV),
+  [CALC_NODE_ETE] = CALC_INPUT_MASK(CALC_INPUT_CLT),
+  [CALC_NODE_AIR_DENSITY] = CALC_INPUT_MASK(CALC_INPUT_IAT),
+  [CALC_NODE_FUEL_DENSITY] = CALC_INPUT_MASK(CALC_INPUT_FRT),
+  [CALC_NODE_SPARK_TRIM] =
+    CALC_INPUT_MASK(CALC_INPUT_RPM) | CALC_INPUT_MASK(CALC_INPUT_MAP),
+  [CALC_NODE_FUEL_TRIM] =
+    CALC_INPUT_MASK(CALC_INPUT_RPM) | CALC_INPUT_MASK(CALC_INPUT_MAP),
+};
+
+/* The fast (per trigger) and slow (task rate) calculations each track their
+ * own inputs and stale terms, so neither writes state the other uses */
+struct calculation_graph {
+  uint32_t inputs; /* Inputs this path's terms depend on */
+  uint32_t stale;
+  /* Input values as of the last time they were considered changed */
+  float values[NUM_CALC_INPUTS];
+  fixed_t fixed_values[NUM_CALC_INPUTS]; /* For the fixed point path */
+};
+
+#define FAST_CALC_INPUTS                                                       \
+  (CALC_INPUT_MASK(CALC_INPUT_RPM) | CALC_INPUT_MASK(CALC_INPUT_MAP) |         \
+   CALC_INPUT_MASK(CALC_INPUT_IAT) | CALC_INPUT_MASK(CALC_INPUT_BRV))
+
+static struct calculation_graph fast_graph = {
+  .inputs = FAST_CALC_INPUTS,
+  .stale = ALL_CALC_NODES,
+};
+
+/* The fixed point calculations keep their own terms, so track them separately
+ * from the float calculations */
+static struct calculation_graph fixed_graph = {
+  .inputs = FAST_CALC_INPUTS,
+  .stale = ALL_CALC_NODES,
+};
+
+static struct calculation_graph slow_graph = {
+  .inputs = CALC_INPUT_MASK(CALC_INPUT_IAT) | CALC_INPUT_MASK(CALC_INPUT_CLT) |
+            CALC_INPUT_MASK(CALC_INPUT_BRV) | CALC_INPUT_MASK(CALC_INPUT_FRT),
+  .stale = ALL_CALC_NODES,
+};
+
+/* Terms that only depend on slowly changing inputs. These are computed at
+ * task rate and published to the trigger path by alternating between two
+ * copies, so that it never sees a partially updated set */
+struct slow_fueling_values {
+  float idt;
+  float air_density;
+  float fuel_density;
+  float clt;
+  /* engine_temp_enrich at the current CLT, for each of its MAP values */
+  float ete_vs_map[MAX_AXIS_SIZE];
+
+  /* Fixed point equivalents for calculate_fueling_fixed(). The constant parts
+   * of the fueling equation are folded into pulse widths per unit */
+  fixed_t idt_us_fixed;
+  fixed_t ete_vs_map_fixed[MAX_AXIS_SIZE];
+  fixed_t us_per_ve_kpa; /* Per VE percent per kPa of MAP at lambda 1 */
+  fixed_t us_per_tipin;  /* Per mm^3 of tipin enrichment */
+  fixed_t crank_rpm;     /* Zero if CLT is above the cranking cutoff */
+  fixed_t crank_enrich;
+};
+
+static struct slow_fueling_values slow_fueling_values[2];
+static volatile uint32_t slow_fueling_current;
+
+/* Timing advance (degrees) and fuel (percent) trims for each cylinder */
+static float cylinder_spark_trims[MAX_CYLINDERS];
+static float cylinder_fuel_trims[MAX_CYLINDERS];
+
+/* Terms kept by the fixed point calculations */
+static fixed_t fixed_timing_advance;
+static fixed_t fixed_ve;
+static fixed_t fixed_lambda;
+static fixed_t fixed_spark_trims[MAX_CYLINDERS];
+static fixed_t fixed_fuel_trims[MAX_CYLINDERS];
+
+static float current_calculation_input(calculation_input i) {
+  switch (i) {
+  case CALC_INPUT_RPM:
+    return config.decoder.rpm;
+  case CALC_INPUT_MAP:
+    return config.sensors[SENSOR_MAP].processed_value;
+  case CALC_INPUT_IAT:
+    return config.sensors[SENSOR_IAT].processed_value;
+  case CALC_INPUT_CLT:
+    return config.sensors[SENSOR_CLT].processed_value;
+  case CALC_INPUT_BRV:
+    return config.sensors[SENSOR_BRV].processed_value;
+  case CALC_INPUT_FRT:
+    return config.sensors[SENSOR_FRT].processed_value;
+  default:
+    return 0.0f;
+  }
+}
+
+/* The fixed point calculations read the sensors' fixed point values, and
+ * compare them against these copies of the input epsilons, updated by
+ * calculations_invalidate() */
+static fixed_t fixed_input_epsilon[NUM_CALC_INPUTS];
+
+static fixed_t current_calculation_input_fixed(calculation_input i) {
+  switch (i) {
+  case CALC_INPUT_RPM:
+    return fixed_from_int(config.decoder.rpm);
+  case CALC_INPUT_MAP:
+    return config.sensors[SENSOR_MAP].processed_fixed;
+  case CALC_INPUT_IAT:
+    return config.sensors[SENSOR_IAT].processed_fixed;
+  case CALC_INPUT_CLT:
+    return config.sensors[SENSOR_CLT].processed_fixed;
+  case CALC_INPUT_BRV:
+    return config.sensors[SENSOR_BRV].processed_fixed;
+  case CALC_INPUT_FRT:
+    return config.sensors[SENSOR_FRT].processed_fixed;
+  default:
+    return 0;
+  }
+}
+
+static void mark_calculation_inputs_changed(struct calculation_graph *g,
+                                            uint32_t changed) {
+  if (!changed) {
+    return;
+  }
+  for (int n = 0; n < NUM_CALC_NODES; n++) {
+    if (calculation_node_inputs[n] & changed) {
+      g->stale |= (1 << n);
+    }
+  }
+}
+
+/* Mark terms stale if any of their inputs have moved by more than that
+ * input's epsilon since the last time it was considered changed */
+static void update_calculation_inputs(struct calculation_graph *g) {
+  uint32_t changed = 0;
+  for (int i = 0; i < NUM_CALC_INPUTS; i++) {
+    if (!(g->inputs & CALC_INPUT_MASK(i))) {
+      continue;
+    }
+    float value = current_calculation_input(i);
+    if (!(fabsf(value - g->values[i]) <=
+          config.calculations.input_epsilon[i])) {
+      g->values[i] = value;
+      changed |= CALC_INPUT_MASK(i);
+    }
+  }
+  mark_calculation_inputs_changed(g, changed);
+}
+
+static void update_calculation_inputs_fixed(struct calculation_graph *g) {
+  uint32_t changed = 0;
+  for (int i = 0; i < NUM_CALC_INPUTS; i++) {
+    if (!(g->inputs & CALC_INPUT_MASK(i))) {
+      continue;
+    }
+    fixed_t value = current_calculation_input_fixed(i);
+    int64_t diff = (int64_t)value - g->fixed_values[i];
+    if ((diff > fixed_input_epsilon[i]) || (-diff > fixed_input_epsilon[i])) {
+      g->fixed_values[i] = value;
+      changed |= CALC_INPUT_MASK(i);
+    }
+  }
+  mark_calculation_inputs_changed(g, changed);
+}
+
+/* Returns true if a term must be recomputed, and counts it as such */
+static bool calculation_node_stale(struct calculation_graph *g,
+                                   calculation_node n) {
+  if (!(g->stale & (1 << n))) {
+    return false;
+  }
+  g->stale &= ~(1 << n);
+  calculation_recomputes[n]++;
+  return true;
+}
+
+void calculations_invalidate() {
+  for (int i = 0; i < NUM_CALC_INPUTS; i++) {
+    fixed_input_epsilon[i] =
+      fixed_from_float(config.calculations.input_epsilon[i]);
+  }
+  fast_graph.stale = ALL_CALC_NODES;
+  slow_graph.stale = ALL_CALC_NODES;
+  fixed_graph.stale = ALL_CALC_NODES;
+}
+
+void calculations_publish() {
+  uint32_t next = published_sequence + 1;
+  published_values[next & 1] = calculated_values;
+  __sync_synchronize();
+  published_sequence = next;
+}
+
+const struct calculated_values *calculations_latest() {
+  return &published_values[published_sequence & 1];
+}
+
+void calculations_snapshot(struct calculated_values *out) {
+  uint32_t seq;
+  do {
+    seq = published_sequence;
+    __sync_synchronize();
+    *out = published_values[seq & 1];
+    __sync_synchronize();
+  } while (seq != published_sequence);
+}
 
 static int fuel_overduty() {
   /* Maximum pulse width */
-  timeval_t max_pw = time_from_rpm_diff(config.decoder.rpm, 720) /
+  timeval_t max_pw = decoder_time_from_degrees(&config.decoder, 720) /
                      config.fueling.injections_per_cycle;
 
-  return time_from_us(calculated_values.fueling_us) >= max_pw;
+  return time_from_us(calculations_latest()->fueling_us) >= max_pw;
 }
 
 static int rpm_limit() {
@@ -36,24 +267,142 @@ bool fuel_cut() {
   return ignition_cut();
 }
 
+/* Tables indexed by rpm and MAP may have a third axis of intake air
+ * temperature, allowing a single trilinear lookup to replace a separate
+ * temperature correction */
+static float interpolate_rpm_map_table(struct table *t,
+                                       float rpm,
+                                       float map,
+                                       float iat) {
+  if (t->num_axis == 3) {
+    return interpolate_table_threeaxis_unchecked(t, rpm, map, iat);
+  }
+  return interpolate_table_twoaxis_unchecked(t, rpm, map);
+}
+
+/* Trim tables are indexed by rpm and MAP, with a layer for each cylinder.
+ * Cylinders without a layer are not trimmed */
+static void interpolate_cylinder_trims(const struct table *t,
+                                       float rpm,
+                                       float map,
+                                       float trims[MAX_CYLINDERS]) {
+  int cylinders = 0;
+  if (t && (t->num_axis == 3)) {
+    interpolate_table_threeaxis_layers_unchecked(t, rpm, map, trims);
+    cylinders = t->axis[2].num;
+  }
+  for (int i = cylinders; i < MAX_CYLINDERS; i++) {
+    trims[i] = 0.0f;
+  }
+}
+
 void calculate_ignition() {
-  calculated_values.timing_advance =
-    interpolate_table_twoaxis(config.timing,
-                              config.decoder.rpm,
-                              config.sensors[SENSOR_MAP].processed_value);
-  switch (config.ignition.dwell) {
-  case DWELL_FIXED_DUTY:
-    calculated_values.dwell_us =
-      time_from_rpm_diff(config.decoder.rpm, 45) / (TICKRATE / 1000000);
-    break;
-  case DWELL_FIXED_TIME:
-    calculated_values.dwell_us = config.ignition.dwell_us;
-    break;
-  case DWELL_BRV:
-    calculated_values.dwell_us =
-      1000 * interpolate_table_oneaxis(
-               config.dwell, config.sensors[SENSOR_BRV].processed_value);
-    break;
+  update_calculation_inputs(&fast_graph);
+
+  float rpm = fast_graph.values[CALC_INPUT_RPM];
+  float map = fast_graph.values[CALC_INPUT_MAP];
+  float iat = fast_graph.values[CALC_INPUT_IAT];
+  float brv = fast_graph.values[CALC_INPUT_BRV];
+
+  if (calculation_node_stale(&fast_graph, CALC_NODE_TIMING)) {
+    calculated_values.timing_advance =
+      interpolate_rpm_map_table(config.timing, rpm, map, iat);
+  }
+
+  if (calculation_node_stale(&fast_graph, CALC_NODE_DWELL)) {
+    switch (config.ignition.dwell) {
+    case DWELL_FIXED_DUTY:
+      calculated_values.dwell_us =
+        time_from_rpm_diff(rpm, 45) / (TICKRATE / 1000000);
+      break;
+    case DWELL_FIXED_TIME:
+      calculated_values.dwell_us = config.ignition.dwell_us;
+      break;
+    case DWELL_BRV:
+      calculated_values.dwell_us =
+        1000 * interpolate_table_oneaxis_unchecked(config.dwell, brv);
+      break;
+    }
+  }
+
+  if (calculation_node_stale(&fast_graph, CALC_NODE_SPARK_TRIM)) {
+    interpolate_cylinder_trims(
+      config.cylinder_spark_trim, rpm, map, cylinder_spark_trims);
+  }
+
+  for (int i = 0; i < MAX_CYLINDERS; i++) {
+    calculated_values.cylinder_timing_advance[i] =
+      calculated_values.timing_advance + cylinder_spark_trims[i] -
+      knock_retard(i);
+  }
+}
+
+static fixed_t interpolate_rpm_map_table_fixed(const struct table *t,
+                                               fixed_t rpm,
+                                               fixed_t map,
+                                               fixed_t iat) {
+  if (t->num_axis == 3) {
+    return interpolate_table_threeaxis_fixed(t, rpm, map, iat);
+  }
+  return interpolate_table_twoaxis_fixed(t, rpm, map);
+}
+
+static void interpolate_cylinder_trims_fixed(const struct table *t,
+                                             fixed_t rpm,
+                                             fixed_t map,
+                                             fixed_t trims[MAX_CYLINDERS]) {
+  int cylinders = 0;
+  if (t && (t->num_axis == 3)) {
+    interpolate_table_threeaxis_layers_fixed(t, rpm, map, trims);
+    cylinders = t->axis[2].num;
+  }
+  for (int i = cylinders; i < MAX_CYLINDERS; i++) {
+    trims[i] = 0;
+  }
+}
+
+void calculate_ignition_fixed() {
+  update_calculation_inputs_fixed(&fixed_graph);
+
+  fixed_t rpm = fixed_graph.fixed_values[CALC_INPUT_RPM];
+  fixed_t map = fixed_graph.fixed_values[CALC_INPUT_MAP];
+  fixed_t iat = fixed_graph.fixed_values[CALC_INPUT_IAT];
+  fixed_t brv = fixed_graph.fixed_values[CALC_INPUT_BRV];
+
+  if (calculation_node_stale(&fixed_graph, CALC_NODE_TIMING)) {
+    fixed_timing_advance =
+      interpolate_rpm_map_table_fixed(config.timing, rpm, map, iat);
+  }
+
+  if (calculation_node_stale(&fixed_graph, CALC_NODE_DWELL)) {
+    switch (config.ignition.dwell) {
+    case DWELL_FIXED_DUTY:
+      calculated_values.dwell_us =
+        time_from_rpm_diff_fixed(fixed_to_int(rpm), fixed_from_int(45)) /
+        (TICKRATE / 1000000);
+      break;
+    case DWELL_FIXED_TIME:
+      calculated_values.dwell_us = config.ignition.dwell_us;
+      break;
+    case DWELL_BRV:
+      calculated_values.dwell_us = fixed_to_int(fixed_mul(
+        fixed_from_int(1000),
+        interpolate_table_oneaxis_fixed(config.dwell, brv)));
+      break;
+    }
+  }
+
+  if (calculation_node_stale(&fixed_graph, CALC_NODE_SPARK_TRIM)) {
+    interpolate_cylinder_trims_fixed(
+      config.cylinder_spark_trim, rpm, map, fixed_spark_trims);
+  }
+
+  calculated_values.timing_advance = fixed_to_float(fixed_timing_advance);
+  for (int i = 0; i < MAX_CYLINDERS; i++) {
+    fixed_t advance = fixed_saturate((int64_t)fixed_timing_advance +
+                                     fixed_spark_trims[i] -
+                                     knock_retard_fixed(i));
+    calculated_values.cylinder_timing_advance[i] = fixed_to_float(advance);
   }
 }
 
@@ -71,23 +420,23 @@ static float fuel_density(float fuel_celsius) {
   return config.fueling.density_of_fuel - (delta_temp * beta / 1000000.0f);
 }
 
-/* Returns mass (g) of air injested into a cylinder */
-static float calculate_airmass(float ve, float map, float iat) {
+/* Returns mass (g) of air injested into a cylinder, given air density in
+ * g/cm^3 */
+static float calculate_airmass(float ve, float map, float density) {
 
   float injested_air_volume_per_cycle =
     (ve / 100.0f) * (map / 100.0f) * config.fueling.cylinder_cc;
 
   float injested_air_mass_per_cycle =
-    injested_air_volume_per_cycle * air_density(iat);
+    injested_air_volume_per_cycle * density;
 
   return injested_air_mass_per_cycle;
 }
 
-/* Given an airmass and a fuel temperature, returns stoich amount of fuel volume
- */
-static float calculate_fuel_volume(float airmass, float frt) {
+/* Given an airmass and a fuel density, returns stoich amount of fuel volume */
+static float calculate_fuel_volume(float airmass, float density) {
   float fuel_mass = airmass / config.fueling.fuel_stoich_ratio;
-  float fuel_volume = fuel_mass / fuel_density(frt);
+  float fuel_volume = fuel_mass / density;
 
   return fuel_volume;
 }
@@ -105,8 +454,8 @@ static float calculate_tipin_enrichment(float tps, float tpsrate, int rpm) {
     return 0.0;
   }
 
-  float new_tipin_amount =
-    interpolate_table_twoaxis(config.tipin_enrich_amount, tpsrate, tps);
+  float new_tipin_amount = interpolate_table_twoaxis_unchecked(
+    config.tipin_enrich_amount, tpsrate, tps);
 
   /* Update status flag */
   if (current.active && !time_in_range(current_time(),
@@ -119,7 +468,8 @@ static float calculate_tipin_enrichment(float tps, float tpsrate, int rpm) {
     /* Overwrite our event */
     current.time = current_time();
     current.length = time_from_us(
-      interpolate_table_oneaxis(config.tipin_enrich_duration, rpm) * 1000);
+      interpolate_table_oneaxis_unchecked(config.tipin_enrich_duration, rpm) *
+      1000);
     current.amount = new_tipin_amount;
     current.active = 1;
   }
@@ -127,63 +477,133 @@ static float calculate_tipin_enrichment(float tps, float tpsrate, int rpm) {
   return current.amount;
 }
 
+void calculate_slow_fueling() {
+  stats_start_timing(STATS_SLOW_FUELCALC_TIME);
+
+  update_calculation_inputs(&slow_graph);
+
+  float iat = slow_graph.values[CALC_INPUT_IAT];
+  float clt = slow_graph.values[CALC_INPUT_CLT];
+  float brv = slow_graph.values[CALC_INPUT_BRV];
+  float frt = slow_graph.values[CALC_INPUT_FRT];
+
+  /* Start from the published copy so that terms not recomputed carry over */
+  uint32_t next_index = !slow_fueling_current;
+  struct slow_fueling_values *next = &slow_fueling_values[next_index];
+  *next = slow_fueling_values[slow_fueling_current];
+
+  next->clt = clt;
+
+  if (calculation_node_stale(&slow_graph, CALC_NODE_IDT)) {
+    if (config.injector_pw_compensation) {
+      next->idt = interpolate_table_oneaxis_unchecked(
+        config.injector_pw_compensation, brv);
+    } else {
+      next->idt = 1.0;
+    }
+  }
+
+  if (calculation_node_stale(&slow_graph, CALC_NODE_ETE)) {
+    if (config.engine_temp_enrich) {
+      interpolate_table_twoaxis_partial(
+        config.engine_temp_enrich, clt, next->ete_vs_map);
+      for (int i = 0; i < config.engine_temp_enrich->axis[1].num; i++) {
+        next->ete_vs_map_fixed[i] = fixed_from_float(next->ete_vs_map[i]);
+      }
+    }
+  }
+
+  if (calculation_node_stale(&slow_graph, CALC_NODE_AIR_DENSITY)) {
+    next->air_density = air_density(iat);
+  }
+
+  if (calculation_node_stale(&slow_graph, CALC_NODE_FUEL_DENSITY)) {
+    next->fuel_density = fuel_density(frt);
+  }
+
+  float us_per_cc = 60000000 / (config.fueling.injector_cc_per_minute *
+                                config.fueling.injections_per_cycle);
+  next->idt_us_fixed = fixed_from_float(next->idt * 1000);
+  next->us_per_ve_kpa = fixed_from_float(
+    config.fueling.cylinder_cc * next->air_density /
+    (10000 * config.fueling.fuel_stoich_ratio * next->fuel_density) *
+    us_per_cc);
+  next->us_per_tipin = fixed_from_float(us_per_cc / 1000);
+  if (clt < config.fueling.crank_enrich_config.cutoff_temperature) {
+    next->crank_rpm =
+      fixed_from_float(config.fueling.crank_enrich_config.crank_rpm);
+  } else {
+    next->crank_rpm = 0;
+  }
+  next->crank_enrich =
+    fixed_from_float(config.fueling.crank_enrich_config.enrich_amt);
+
+  /* The new copy must be complete before the trigger path can see it */
+  __sync_synchronize();
+  slow_fueling_current = next_index;
+
+  stats_finish_timing(STATS_SLOW_FUELCALC_TIME);
+}
+
 void calculate_fueling() {
   stats_start_timing(STATS_FUELCALC_TIME);
 
-  float ve;
-  float lambda;
-  float idt;
-  float ete;
+  update_calculation_inputs(&fast_graph);
 
-  float iat = config.sensors[SENSOR_IAT].processed_value;
-  float brv = config.sensors[SENSOR_BRV].processed_value;
-  float map = config.sensors[SENSOR_MAP].processed_value;
-  float frt = config.sensors[SENSOR_FRT].processed_value;
-  float clt = config.sensors[SENSOR_CLT].processed_value;
+  float rpm = fast_graph.values[CALC_INPUT_RPM];
+  float map = fast_graph.values[CALC_INPUT_MAP];
+  float iat = fast_graph.values[CALC_INPUT_IAT];
 
   float tps = config.sensors[SENSOR_TPS].processed_value;
   float tpsrate = config.sensors[SENSOR_TPS].derivative.value;
 
-  if (config.ve) {
-    ve = interpolate_table_twoaxis(config.ve, config.decoder.rpm, map);
-  } else {
-    ve = 100.0;
-  }
+  const struct slow_fueling_values *slow =
+    &slow_fueling_values[slow_fueling_current];
 
-  if (config.commanded_lambda) {
-    lambda = interpolate_table_twoaxis(
-      config.commanded_lambda, config.decoder.rpm, map);
-  } else {
-    lambda = 1.0;
+  if (calculation_node_stale(&fast_graph, CALC_NODE_VE)) {
+    if (config.ve) {
+      calculated_values.ve =
+        interpolate_rpm_map_table(config.ve, rpm, map, iat);
+    } else {
+      calculated_values.ve = 100.0;
+    }
   }
 
-  if (config.injector_pw_compensation) {
-    idt = interpolate_table_oneaxis(config.injector_pw_compensation, brv);
-  } else {
-    idt = 1.0;
+  if (calculation_node_stale(&fast_graph, CALC_NODE_LAMBDA)) {
+    if (config.commanded_lambda) {
+      calculated_values.lambda =
+        interpolate_rpm_map_table(config.commanded_lambda, rpm, map, iat);
+    } else {
+      calculated_values.lambda = 1.0;
+    }
   }
 
+  calculated_values.idt = slow->idt;
+
   if (config.engine_temp_enrich) {
-    ete = interpolate_table_twoaxis(config.engine_temp_enrich, clt, map);
+    calculated_values.ete = interpolate_table_twoaxis_complete(
+      config.engine_temp_enrich, slow->ete_vs_map, map);
   } else {
-    ete = 1.0;
+    calculated_values.ete = 1.0;
   }
 
   /* Cranking enrichment config overrides ETE */
-  if ((config.decoder.rpm < config.fueling.crank_enrich_config.crank_rpm) &&
-      (clt < config.fueling.crank_enrich_config.cutoff_temperature)) {
-    ete = config.fueling.crank_enrich_config.enrich_amt;
+  if ((rpm < config.fueling.crank_enrich_config.crank_rpm) &&
+      (slow->clt < config.fueling.crank_enrich_config.cutoff_temperature)) {
+    calculated_values.ete = config.fueling.crank_enrich_config.enrich_amt;
   }
 
-  calculated_values.tipin =
-    calculate_tipin_enrichment(tps, tpsrate, config.decoder.rpm);
+  /* Tipin enrichment is time dependent, so is always evaluated */
+  calculated_values.tipin = calculate_tipin_enrichment(tps, tpsrate, rpm);
 
-  calculated_values.airmass_per_cycle = calculate_airmass(ve, map, iat);
+  calculated_values.airmass_per_cycle =
+    calculate_airmass(calculated_values.ve, map, slow->air_density);
 
-  float fuel_vol_at_stoich =
-    calculate_fuel_volume(calculated_values.airmass_per_cycle, frt);
+  float fuel_vol_at_stoich = calculate_fuel_volume(
+    calculated_values.airmass_per_cycle, slow->fuel_density);
 
-  calculated_values.fuelvol_per_cycle = fuel_vol_at_stoich / lambda;
+  calculated_values.fuelvol_per_cycle =
+    fuel_vol_at_stoich / calculated_values.lambda;
 
   float raw_pw_us =
     (calculated_values.fuelvol_per_cycle +
@@ -192,18 +612,147 @@ void calculate_fueling() {
     60000000 /                           /* uS per minute */
     config.fueling.injections_per_cycle; /* This many pulses */
 
-  calculated_values.ete = ete;
-  calculated_values.idt = idt;
-  calculated_values.ve = ve;
-  calculated_values.lambda = lambda;
-  calculated_values.fueling_us = (raw_pw_us * ete) + (idt * 1000);
+  float pw_us = raw_pw_us * calculated_values.ete;
+  float idt_us = calculated_values.idt * 1000;
+  calculated_values.fueling_us = pw_us + idt_us;
+
+  if (calculation_node_stale(&fast_graph, CALC_NODE_FUEL_TRIM)) {
+    interpolate_cylinder_trims(
+      config.cylinder_fuel_trim, rpm, map, cylinder_fuel_trims);
+  }
+
+  /* Trims apply to the fuel quantity, not the injector dead time */
+  for (int i = 0; i < MAX_CYLINDERS; i++) {
+    calculated_values.cylinder_fueling_us[i] =
+      pw_us * (1.0f + cylinder_fuel_trims[i] / 100.0f) + idt_us;
+  }
+
+  stats_finish_timing(STATS_FUELCALC_TIME);
+}
+
+/* Rounds a Q16.16 pulse width to whole microseconds */
+static uint32_t fixed_pulse_width_us(int64_t pw) {
+  int64_t us = fixed_descale(pw);
+  if (us < 0) {
+    return 0;
+  }
+  if (us > UINT32_MAX) {
+    return UINT32_MAX;
+  }
+  return us;
+}
+
+void calculate_fueling_fixed() {
+  stats_start_timing(STATS_FUELCALC_TIME);
+
+  update_calculation_inputs_fixed(&fixed_graph);
+
+  fixed_t rpm = fixed_graph.fixed_values[CALC_INPUT_RPM];
+  fixed_t map = fixed_graph.fixed_values[CALC_INPUT_MAP];
+  fixed_t iat = fixed_graph.fixed_values[CALC_INPUT_IAT];
+
+  float tps = config.sensors[SENSOR_TPS].processed_value;
+  float tpsrate = config.sensors[SENSOR_TPS].derivative.value;
+
+  const struct slow_fueling_values *slow =
+    &slow_fueling_values[slow_fueling_current];
+
+  if (calculation_node_stale(&fixed_graph, CALC_NODE_VE)) {
+    if (config.ve) {
+      fixed_ve = interpolate_rpm_map_table_fixed(config.ve, rpm, map, iat);
+    } else {
+      fixed_ve = fixed_from_int(100);
+    }
+  }
+
+  if (calculation_node_stale(&fixed_graph, CALC_NODE_LAMBDA)) {
+    if (config.commanded_lambda) {
+      fixed_lambda =
+        interpolate_rpm_map_table_fixed(config.commanded_lambda, rpm, map, iat);
+    } else {
+      fixed_lambda = FIXED_ONE;
+    }
+  }
+
+  fixed_t ete = FIXED_ONE;
+  if (config.engine_temp_enrich) {
+    ete = interpolate_table_twoaxis_complete_fixed(
+      config.engine_temp_enrich, slow->ete_vs_map_fixed, map);
+  }
+
+  /* Cranking enrichment config overrides ETE */
+  if (rpm < slow->crank_rpm) {
+    ete = slow->crank_enrich;
+  }
+
+  /* Tipin enrichment keeps float state, and is converted */
+  calculated_values.tipin =
+    calculate_tipin_enrichment(tps, tpsrate, fixed_to_int(rpm));
+  fixed_t tipin = fixed_from_float(calculated_values.tipin);
+
+  /* A non-positive lambda is a misconfiguration, avoid dividing by it */
+  fixed_t lambda = (fixed_lambda > 0) ? fixed_lambda : 1;
+
+  /* Intermediate Q16.16 values may exceed the range of fixed_t */
+  int64_t pw = fixed_descale((int64_t)fixed_ve * map);
+  pw = fixed_descale(pw * slow->us_per_ve_kpa);
+  pw = fixed_round_div(pw * FIXED_ONE, lambda);
+  pw += fixed_descale((int64_t)tipin * slow->us_per_tipin);
+  pw = fixed_descale(pw * ete);
+
+  calculated_values.fueling_us = fixed_pulse_width_us(pw + slow->idt_us_fixed);
+
+  if (calculation_node_stale(&fixed_graph, CALC_NODE_FUEL_TRIM)) {
+    interpolate_cylinder_trims_fixed(
+      config.cylinder_fuel_trim, rpm, map, fixed_fuel_trims);
+  }
+
+  /* Trims apply to the fuel quantity, not the injector dead time */
+  for (int i = 0; i < MAX_CYLINDERS; i++) {
+    int64_t trim =
+      fixed_round_div(pw * fixed_fuel_trims[i], fixed_from_int(100));
+    calculated_values.cylinder_fueling_us[i] =
+      fixed_pulse_width_us(pw + trim + slow->idt_us_fixed);
+  }
+
+  calculated_values.ve = fixed_to_float(fixed_ve);
+  calculated_values.lambda = fixed_to_float(fixed_lambda);
+  calculated_values.ete = fixed_to_float(ete);
+  calculated_values.idt = slow->idt;
 
   stats_finish_timing(STATS_FUELCALC_TIME);
 }
 
+void calculations_update() {
+  /* The lookups rely on tables having been validated */
+  if (!config_is_valid()) {
+    return;
+  }
+#ifdef FIXED_POINT_CALCULATIONS
+  calculate_ignition_fixed();
+  calculate_fueling_fixed();
+#else
+  calculate_ignition();
+  calculate_fueling();
+#endif
+  calculations_publish();
+}
+
+void calculations_update_periodic() {
+  static timeval_t last_run = 0;
+
+  if (time_diff(current_time(), last_run) <
+      time_from_us(config.calculations.main_loop_interval_us)) {
+    return;
+  }
+  last_run = current_time();
+  calculations_update();
+}
+
 #ifdef UNITTEST
 #include <check.h>
 #include <stdlib.h>
+#include <string.h>
 
 START_TEST(check_air_density) {
   ck_assert_float_eq_tol(air_density(0), 1.2922e-3, 0.000001);
@@ -222,14 +771,17 @@ START_TEST(check_calculate_airmass) {
   /* Airmass for perfect VE, full map, 0 C*/
   config.sensors[SENSOR_IAT].processed_value = 0.0f;
   config.fueling.cylinder_cc = 500;
-  float airmass = calculate_airmass(100, 100, 0);
+  float density = air_density(0);
+  float airmass = calculate_airmass(100, 100, density);
   ck_assert_float_eq_tol(airmass, 0.646100, 0.001);
 
   /* 70 MAP should be 70% of previous airmass */
-  ck_assert_float_eq_tol(calculate_airmass(100, 70, 0), 0.7 * airmass, 0.001);
+  ck_assert_float_eq_tol(
+    calculate_airmass(100, 70, density), 0.7 * airmass, 0.001);
 
   /* 80 VE should be 80% of first airmass */
-  ck_assert_float_eq_tol(calculate_airmass(80, 100, 0), 0.8 * airmass, 0.001);
+  ck_assert_float_eq_tol(
+    calculate_airmass(80, 100, density), 0.8 * airmass, 0.001);
 }
 END_TEST
 
@@ -239,21 +791,77 @@ START_TEST(check_fuel_overduty) {
   config.decoder.rpm = 6000;
   config.fueling.injections_per_cycle = 1;
   calculated_values.fueling_us = 18000;
+  calculations_publish();
   ck_assert(!fuel_overduty());
 
   calculated_values.fueling_us = 21000;
+  calculations_publish();
   ck_assert(fuel_overduty());
 
   /* Test batch injection */
   config.fueling.injections_per_cycle = 2;
   calculated_values.fueling_us = 11000;
+  calculations_publish();
   ck_assert(fuel_overduty());
 
   calculated_values.fueling_us = 8000;
+  calculations_publish();
   ck_assert(!fuel_overduty());
 }
 END_TEST
 
+START_TEST(check_calculations_publish) {
+  calculated_values.fueling_us = 1000;
+  calculated_values.timing_advance = 10;
+  calculations_publish();
+
+  /* Further calculation is not visible until published */
+  calculated_values.fueling_us = 2000;
+  calculated_values.timing_advance = 20;
+  ck_assert_int_eq(calculations_latest()->fueling_us, 1000);
+
+  struct calculated_values snapshot;
+  calculations_snapshot(&snapshot);
+  ck_assert_int_eq(snapshot.fueling_us, 1000);
+  ck_assert_float_eq(snapshot.timing_advance, 10);
+
+  calculations_publish();
+  calculations_snapshot(&snapshot);
+  ck_assert_int_eq(snapshot.fueling_us, 2000);
+  ck_assert_float_eq(snapshot.timing_advance, 20);
+  ck_assert_int_eq(calculations_latest()->fueling_us, 2000);
+}
+END_TEST
+
+START_TEST(check_calculations_update_periodic) {
+  config.calculations.main_loop_interval_us = 1000;
+  config.decoder.rpm = 2000;
+  sensor_set_value(&config.sensors[SENSOR_MAP], 100);
+  calculate_slow_fueling();
+  calculated_values.fueling_us = 1;
+  calculations_publish();
+
+  /* Nothing is calculated until the interval has passed */
+  set_current_time(time_from_us(999));
+  calculations_update_periodic();
+  ck_assert_int_eq(calculations_latest()->fueling_us, 1);
+
+  set_current_time(time_from_us(1000));
+  calculations_update_periodic();
+  ck_assert_int_gt(calculations_latest()->fueling_us, 1);
+
+  /* The interval restarts from the last update */
+  calculated_values.fueling_us = 1;
+  calculations_publish();
+  set_current_time(time_from_us(1999));
+  calculations_update_periodic();
+  ck_assert_int_eq(calculations_latest()->fueling_us, 1);
+  set_current_time(time_from_us(2000));
+  calculations_update_periodic();
+  ck_assert_int_gt(calculations_latest()->fueling_us, 1);
+}
+END_TEST
+
 START_TEST(check_calculate_ignition_cut) {
   config.rpm_stop = 5000;
   config.rpm_start = 4500;
@@ -287,6 +895,7 @@ START_TEST(check_calculate_ignition_fixedduty) {
               { .num = 2, .values = { 5, 10 } } },
     .data = { .two = { { 10, 10 }, { 10, 10 } } },
   };
+  ck_assert(table_valid(&t));
   config.timing = &t;
   config.ignition.dwell = DWELL_FIXED_DUTY;
   config.decoder.rpm = 6000;
@@ -300,6 +909,224 @@ START_TEST(check_calculate_ignition_fixedduty) {
 }
 END_TEST
 
+START_TEST(check_calculate_ignition_threeaxis) {
+  struct table t = {
+    .num_axis = 3,
+    .axis = { { .num = 2, .values = { 5, 10 } },
+              { .num = 2, .values = { 5, 10 } },
+              { .num = 2, .values = { 0, 100 } } },
+    .data = { .three = { { { 20, 20 }, { 20, 20 } },
+                         { { 10, 10 }, { 10, 10 } } } },
+  };
+  ck_assert(table_valid(&t));
+  config.timing = &t;
+  config.ignition.dwell = DWELL_FIXED_TIME;
+  config.decoder.rpm = 6000;
+
+  config.sensors[SENSOR_IAT].processed_value = 0;
+  calculate_ignition();
+  ck_assert(calculated_values.timing_advance == 20);
+
+  config.sensors[SENSOR_IAT].processed_value = 50;
+  calculate_ignition();
+  ck_assert(calculated_values.timing_advance == 15);
+}
+END_TEST
+
+START_TEST(check_calculation_recompute) {
+  /* Startup has already computed the slow terms once */
+  calculations_invalidate();
+  memset(calculation_recomputes, 0, sizeof(calculation_recomputes));
+
+  config.calculations.input_epsilon[CALC_INPUT_RPM] = 10;
+  config.calculations.input_epsilon[CALC_INPUT_CLT] = 0.5;
+  config.decoder.rpm = 2000;
+  config.sensors[SENSOR_MAP].processed_value = 100;
+  config.sensors[SENSOR_CLT].processed_value = 80;
+
+  calculate_slow_fueling();
+  calculate_fueling();
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_VE], 1);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_ETE], 1);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_IDT], 1);
+  uint32_t fueling_us = calculated_values.fueling_us;
+
+  /* Changes within epsilon recompute nothing */
+  config.decoder.rpm = 2005;
+  config.sensors[SENSOR_CLT].processed_value = 80.4;
+  calculate_slow_fueling();
+  calculate_fueling();
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_VE], 1);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_ETE], 1);
+  ck_assert_int_eq(calculated_values.fueling_us, fueling_us);
+
+  /* CLT change only recomputes dependent terms */
+  config.sensors[SENSOR_CLT].processed_value = 90;
+  calculate_slow_fueling();
+  calculate_fueling();
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_VE], 1);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_ETE], 2);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_IDT], 1);
+
+  /* RPM change recomputes rpm dependent terms, none of which are slow */
+  config.decoder.rpm = 3000;
+  calculate_slow_fueling();
+  calculate_fueling();
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_VE], 2);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_LAMBDA], 2);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_ETE], 2);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_IDT], 1);
+
+  calculations_invalidate();
+  calculate_slow_fueling();
+  calculate_fueling();
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_VE], 3);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_IDT], 2);
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_FUEL_DENSITY], 2);
+}
+END_TEST
+
+START_TEST(check_calculate_slow_fueling) {
+  struct table ete = {
+    .num_axis = 2,
+    .axis = { { .num = 2, .values = { 0, 100 } },
+              { .num = 2, .values = { 0, 100 } } },
+    .data = { .two = { { 2.0, 1.0 }, { 3.0, 1.0 } } },
+  };
+  ck_assert(table_valid(&ete));
+  config.engine_temp_enrich = &ete;
+  config.fueling.crank_enrich_config.crank_rpm = 400;
+  config.fueling.crank_enrich_config.cutoff_temperature = 20;
+  config.fueling.crank_enrich_config.enrich_amt = 4.0;
+  config.decoder.rpm = 2000;
+  config.sensors[SENSOR_MAP].processed_value = 50;
+  config.sensors[SENSOR_CLT].processed_value = 50;
+
+  calculate_slow_fueling();
+  calculate_fueling();
+  ck_assert_float_eq_tol(calculated_values.ete, 1.75, 0.0001);
+  uint32_t fueling_us = calculated_values.fueling_us;
+
+  /* Slow terms only change once recomputed */
+  config.sensors[SENSOR_CLT].processed_value = 0;
+  config.sensors[SENSOR_IAT].processed_value = 50;
+  calculate_fueling();
+  ck_assert_float_eq_tol(calculated_values.ete, 1.75, 0.0001);
+  ck_assert_int_eq(calculated_values.fueling_us, fueling_us);
+
+  calculate_slow_fueling();
+  calculate_fueling();
+  ck_assert_float_eq_tol(calculated_values.ete, 2.5, 0.0001);
+  ck_assert_int_lt(calculated_values.fueling_us, fueling_us * 2.5 / 1.75);
+
+  /* MAP is applied to the slow terms on every call */
+  config.sensors[SENSOR_MAP].processed_value = 100;
+  calculate_fueling();
+  ck_assert_float_eq_tol(calculated_values.ete, 3.0, 0.0001);
+
+  /* Cranking override uses the slow CLT */
+  config.decoder.rpm = 300;
+  calculate_fueling();
+  ck_assert_float_eq_tol(calculated_values.ete, 4.0, 0.0001);
+}
+END_TEST
+
+START_TEST(check_calculate_cylinder_trims) {
+  struct table trim = {
+    .num_axis = 3,
+    .axis = { { .num = 2, .values = { 1000, 5000 } },
+              { .num = 2, .values = { 20, 100 } },
+              { .num = 2, .values = { 0, 1 } } },
+    .data = { .three = { { { 0, 0 }, { 0, 0 } },
+                         { { 10, 20 }, { 10, 20 } } } },
+  };
+  ck_assert(table_valid(&trim));
+  config.cylinder_spark_trim = &trim;
+  config.cylinder_fuel_trim = &trim;
+  config.ignition.dwell = DWELL_FIXED_TIME;
+  config.decoder.rpm = 3000;
+  config.sensors[SENSOR_MAP].processed_value = 50;
+
+  calculate_ignition();
+  float advance = calculated_values.timing_advance;
+  ck_assert_float_eq(calculated_values.cylinder_timing_advance[0], advance);
+  ck_assert_float_eq_tol(
+    calculated_values.cylinder_timing_advance[1], advance + 15, 0.0001);
+  /* Cylinders without a layer are untrimmed */
+  ck_assert_float_eq(calculated_values.cylinder_timing_advance[2], advance);
+
+  calculate_fueling();
+  float pw = calculated_values.fueling_us - calculated_values.idt * 1000;
+  ck_assert_int_eq(calculated_values.cylinder_fueling_us[0],
+                   calculated_values.fueling_us);
+  ck_assert_float_eq_tol(calculated_values.cylinder_fueling_us[1],
+                         calculated_values.fueling_us + pw * 0.15,
+                         1.0);
+  ck_assert_int_eq(calculated_values.cylinder_fueling_us[7],
+                   calculated_values.fueling_us);
+
+  /* Trims are only recomputed for rpm or MAP changes */
+  uint32_t recomputes = calculation_recomputes[CALC_NODE_FUEL_TRIM];
+  calculate_fueling();
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_FUEL_TRIM], recomputes);
+  config.decoder.rpm = 4000;
+  calculate_fueling();
+  ck_assert_int_eq(calculation_recomputes[CALC_NODE_FUEL_TRIM],
+                   recomputes + 1);
+}
+END_TEST
+
+#ifdef FIXED_POINT_CALCULATIONS
+/* The fixed point calculations must agree with the float calculations over
+ * the default config's tables, to within rounding */
+START_TEST(check_calculate_fixed_matches_float) {
+  float trim_data[MAX_CYLINDERS] = { -5, 0, 3.5, 10 };
+  for (int i = 0; i < MAX_CYLINDERS; i++) {
+    config.cylinder_fuel_trim->data.three[i][0][0] = trim_data[i];
+    config.cylinder_spark_trim->data.three[i][1][1] = trim_data[i];
+  }
+  ck_assert(table_valid(config.cylinder_fuel_trim));
+  ck_assert(table_valid(config.cylinder_spark_trim));
+
+  for (float clt = -20; clt < 120; clt += 35) {
+    sensor_set_value(&config.sensors[SENSOR_CLT], clt);
+    sensor_set_value(&config.sensors[SENSOR_IAT], clt / 2);
+    sensor_set_value(&config.sensors[SENSOR_BRV], 11 + clt / 40);
+    calculate_slow_fueling();
+
+    for (unsigned int rpm = 100; rpm < 8000; rpm += 430) {
+      for (float map = 15; map < 250; map += 17.3f) {
+        config.decoder.rpm = rpm;
+        sensor_set_value(&config.sensors[SENSOR_MAP], map);
+
+        calculate_ignition();
+        calculate_fueling();
+        struct calculated_values expected = calculated_values;
+
+        calculate_ignition_fixed();
+        calculate_fueling_fixed();
+
+        ck_assert_float_eq_tol(
+          calculated_values.timing_advance, expected.timing_advance, 0.01);
+        ck_assert_float_eq_tol(
+          calculated_values.dwell_us, expected.dwell_us, 1);
+        for (int i = 0; i < MAX_CYLINDERS; i++) {
+          ck_assert_float_eq_tol(calculated_values.cylinder_timing_advance[i],
+                                 expected.cylinder_timing_advance[i],
+                                 0.01);
+          ck_assert_float_eq_tol(calculated_values.cylinder_fueling_us[i],
+                                 expected.cylinder_fueling_us[i],
+                                 1);
+        }
+        ck_assert_float_eq_tol(
+          calculated_values.fueling_us, expected.fueling_us, 1);
+      }
+    }
+  }
+}
+END_TEST
+#endif
+
 static struct table tipin_amount = {
   .num_axis = 2,
   .axis = { { .num = 2, .values = { 0, 100 } },
@@ -315,6 +1142,8 @@ static struct table tipin_duration = {
 
 START_TEST(check_calculate_tipin_newevent) {
 
+  ck_assert(table_valid(&tipin_amount));
+  ck_assert(table_valid(&tipin_duration));
   config.tipin_enrich_amount = &tipin_amount;
   config.tipin_enrich_duration = &tipin_duration;
 
@@ -334,6 +1163,8 @@ END_TEST
 
 START_TEST(check_calculate_tipin_overriding_event) {
 
+  ck_assert(table_valid(&tipin_amount));
+  ck_assert(table_valid(&tipin_duration));
   config.tipin_enrich_amount = &tipin_amount;
   config.tipin_enrich_duration = &tipin_duration;
 
@@ -373,8 +1204,17 @@ TCase *setup_calculations_tests() {
   tcase_add_test(tc, check_fuel_density);
   tcase_add_test(tc, check_calculate_airmass);
   tcase_add_test(tc, check_fuel_overduty);
+  tcase_add_test(tc, check_calculations_publish);
+  tcase_add_test(tc, check_calculations_update_periodic);
   tcase_add_test(tc, check_calculate_ignition_cut);
   tcase_add_test(tc, check_calculate_ignition_fixedduty);
+  tcase_add_test(tc, check_calculate_ignition_threeaxis);
+  tcase_add_test(tc, check_calculation_recompute);
+  tcase_add_test(tc, check_calculate_slow_fueling);
+  tcase_add_test(tc, check_calculate_cylinder_trims);
+#ifdef FIXED_POINT_CALCULATIONS
+  tcase_add_test(tc, check_calculate_fixed_matches_float);
+#endif
 
   tcase_add_test(tc, check_calculate_tipin_newevent);
   tcase_add_test(tc, check_calculate_tipin_overriding_event);
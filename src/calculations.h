@@ -4,6 +4,11 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "table.h"
+
+/* Per-cylinder trims are the layers of a three axis table */
+#define MAX_CYLINDERS MAX_3D_AXIS_SIZE
+
 struct fueling_config {
   float injector_cc_per_minute;
   float cylinder_cc;
@@ -35,6 +40,41 @@ struct ignition_config {
   uint32_t min_fire_time_us;
 };
 
+/* Inputs to the calculations. Terms that depend on an input are only
+ * recomputed when it moves by more than its configured epsilon */
+typedef enum {
+  CALC_INPUT_RPM,
+  CALC_INPUT_MAP,
+  CALC_INPUT_IAT,
+  CALC_INPUT_CLT,
+  CALC_INPUT_BRV,
+  CALC_INPUT_FRT,
+  NUM_CALC_INPUTS,
+} calculation_input;
+
+/* Intermediate terms of the calculations */
+typedef enum {
+  CALC_NODE_TIMING,
+  CALC_NODE_DWELL,
+  CALC_NODE_VE,
+  CALC_NODE_LAMBDA,
+  CALC_NODE_IDT,
+  CALC_NODE_ETE,
+  CALC_NODE_AIR_DENSITY,
+  CALC_NODE_FUEL_DENSITY,
+  CALC_NODE_SPARK_TRIM,
+  CALC_NODE_FUEL_TRIM,
+  NUM_CALC_NODES,
+} calculation_node;
+
+struct calculation_config {
+  float input_epsilon[NUM_CALC_INPUTS];
+  uint32_t slow_interval_us; /* Period of calculate_slow_fueling() */
+  uint32_t main_loop;        /* Run calculations_update() from the main loop
+                                rather than on each trigger */
+  uint32_t main_loop_interval_us; /* Minimum period of main loop updates */
+};
+
 struct calculated_values {
   /* Ignition */
   float timing_advance;
@@ -50,15 +90,59 @@ struct calculated_values {
   float lambda;
   float ve;
   float ete;
+
+  /* Per-cylinder results, including trims */
+  float cylinder_timing_advance[MAX_CYLINDERS];
+  uint32_t cylinder_fueling_us[MAX_CYLINDERS];
 };
 
+/* Working copy written by the calculate_*() functions. Consumers should use
+ * the values published by calculations_publish() */
 extern struct calculated_values calculated_values;
 
+/* Number of times each intermediate term has been recomputed */
+extern uint32_t calculation_recomputes[NUM_CALC_NODES];
+
 void calculate_ignition();
 void calculate_fueling();
+/* Integer and Q16.16 versions of calculate_ignition() and calculate_fueling(),
+ * with deterministic rounding. These are used by the decoder when built with
+ * FIXED_POINT_CALCULATIONS. The airmass and fuel volume intermediates are only
+ * produced by the float versions */
+void calculate_ignition_fixed();
+void calculate_fueling_fixed();
+/* Computes the fueling terms that only depend on temperatures and battery
+ * voltage, for use by later calls to calculate_fueling() */
+void calculate_slow_fueling();
 bool ignition_cut();
 bool fuel_cut();
 
+/* Force all terms to be recomputed, such as after a config change. This also
+ * refreshes the fixed point copies of the input epsilons */
+void calculations_invalidate();
+
+/* Calculate ignition and fueling, with the fixed point versions if built with
+ * FIXED_POINT_CALCULATIONS, and publish the results */
+void calculations_update();
+
+/* calculations_update() for the main loop, if main_loop_interval_us has
+ * passed since the last. Since the main loop also runs console_process(),
+ * the published values are at most main_loop_interval_us plus one console
+ * pass old when the trigger path schedules with them */
+void calculations_update_periodic();
+
+/* Publish the working calculated_values as a consistent set. Publishing only
+ * writes the buffer not currently published, so a reader is only disturbed
+ * by a second publish during its read */
+void calculations_publish();
+
+/* Latest published values. For short reads from interrupt context, such as
+ * scheduling, that cannot span two publishes */
+const struct calculated_values *calculations_latest();
+
+/* Consistent copy of the latest published values, from any context */
+void calculations_snapshot(struct calculated_values *);
+
 #ifdef UNITTEST
 #include <check.h>
 TCase *setup_calculations_tests();
@@ -0,0 +1,281 @@
+#include "capture.h"
+#include "config.h"
+#include "decoder.h"
+#include "platform.h"
+#include "stats.h"
+
+#define CAPTURE_WORDS (CAPTURE_BUFFER_SIZE / sizeof(uint16_t))
+
+typedef enum {
+  CAPTURE_IDLE,
+  CAPTURE_ARMED, /* Waiting for the start of the next cycle */
+  CAPTURE_RECORDING,
+  CAPTURE_SENDING,
+} capture_state;
+
+static struct {
+  volatile capture_state state;
+  uint32_t sensors;
+  uint32_t cycles;
+  uint32_t cycles_recorded;
+  uint32_t record_words;
+  degrees_t last_angle;
+  uint32_t words;
+  uint32_t sent;
+} capture;
+
+/* Only written and read by the CPU, so may be in memory DMA can't reach. The
+ * .ccm section isn't initialized at startup */
+static uint16_t capture_buffer[CAPTURE_WORDS]
+  __attribute__((section(".ccm")));
+
+bool capture_start(uint32_t sensors, uint32_t cycles) {
+  if (!cycles) {
+    return false;
+  }
+
+  uint32_t record_words = 1;
+  for (int i = 0; i < NUM_SENSORS; i++) {
+    if (!(sensors & (1 << i))) {
+      continue;
+    }
+    if (config.sensors[i].source != SENSOR_ADC) {
+      return false;
+    }
+    record_words++;
+  }
+  if (sensors >= (1 << NUM_SENSORS)) {
+    return false;
+  }
+
+  disable_interrupts();
+  capture.sensors = sensors;
+  capture.cycles = cycles;
+  capture.cycles_recorded = 0;
+  capture.record_words = record_words;
+  capture.last_angle = 0;
+  capture.words = 0;
+  capture.sent = 0;
+  capture.state = CAPTURE_ARMED;
+  enable_interrupts();
+  return true;
+}
+
+void capture_cancel() {
+  capture.state = CAPTURE_IDLE;
+}
+
+bool capture_recording() {
+  return (capture.state == CAPTURE_ARMED) ||
+         (capture.state == CAPTURE_RECORDING);
+}
+
+static void capture_finish() {
+  /* Samples must be in memory before the console can see they're ready */
+  __sync_synchronize();
+  capture.state = CAPTURE_SENDING;
+}
+
+/* Runs from the ADC interrupt, so does as little as possible per sample: one
+ * angle calculation and a copy of the raw values */
+static void capture_sample() {
+  if (!config.decoder.valid) {
+    /* Losing sync ends a capture, keeping what was recorded */
+    if (capture.state == CAPTURE_RECORDING) {
+      capture_finish();
+    }
+    capture.last_angle = 0;
+    return;
+  }
+
+  degrees_t angle = current_angle();
+  /* current_angle() can step back slightly at each tooth, so only a large
+   * step back is the start of a new cycle */
+  bool new_cycle = angle < capture.last_angle - 360;
+  capture.last_angle = angle;
+
+  if (capture.state == CAPTURE_ARMED) {
+    if (!new_cycle) {
+      return;
+    }
+    capture.state = CAPTURE_RECORDING;
+  } else if (new_cycle) {
+    capture.cycles_recorded++;
+    if (capture.cycles_recorded == capture.cycles) {
+      capture_finish();
+      return;
+    }
+  }
+
+  if (capture.words + capture.record_words > CAPTURE_WORDS) {
+    capture_finish();
+    return;
+  }
+
+  uint16_t *record = &capture_buffer[capture.words];
+  *record++ = (uint16_t)(angle * 10);
+  for (int i = 0; i < NUM_SENSORS; i++) {
+    if (capture.sensors & (1 << i)) {
+      *record++ = config.sensors[i].raw_value;
+    }
+  }
+  capture.words += capture.record_words;
+}
+
+void capture_record() {
+  if (!capture_recording()) {
+    return;
+  }
+  stats_start_timing(STATS_CAPTURE_TIME);
+  capture_sample();
+  stats_finish_timing(STATS_CAPTURE_TIME);
+}
+
+bool capture_next_chunk(struct capture_chunk *chunk) {
+  if (capture.state != CAPTURE_SENDING) {
+    return false;
+  }
+
+  uint32_t total = capture.words * sizeof(uint16_t);
+  uint32_t length = total - capture.sent;
+  if (length > CAPTURE_CHUNK_SIZE) {
+    length = CAPTURE_CHUNK_SIZE;
+  }
+
+  *chunk = (struct capture_chunk){
+    .sensors = capture.sensors,
+    .cycles = capture.cycles_recorded,
+    .offset = capture.sent,
+    .total = total,
+    .data = (const uint8_t *)capture_buffer + capture.sent,
+    .length = length,
+  };
+
+  capture.sent += length;
+  if (capture.sent == total) {
+    capture.state = CAPTURE_IDLE;
+  }
+  return true;
+}
+
+#ifdef UNITTEST
+#include <check.h>
+
+static void capture_at_angle(degrees_t angle) {
+  config.decoder.last_trigger_angle = angle;
+  capture_record();
+}
+
+START_TEST(check_capture_records_cycles) {
+  config.decoder.valid = 1;
+  config.decoder.rpm = 0;
+  config.sensors[SENSOR_MAP].source = SENSOR_ADC;
+  config.sensors[SENSOR_EGO].source = SENSOR_ADC;
+  config.sensors[SENSOR_MAP].raw_value = 100;
+  config.sensors[SENSOR_EGO].raw_value = 200;
+
+  ck_assert(capture_start((1 << SENSOR_MAP) | (1 << SENSOR_EGO), 2));
+
+  /* Nothing is recorded until the start of a cycle */
+  capture_at_angle(600);
+  capture_at_angle(700);
+  ck_assert(capture_recording());
+
+  capture_at_angle(10.5);
+  capture_at_angle(9); /* Small steps back are not a new cycle */
+  capture_at_angle(400);
+  capture_at_angle(5);
+  capture_at_angle(650);
+  ck_assert(capture_recording());
+
+  /* Start of the third cycle finishes the capture */
+  capture_at_angle(20);
+  ck_assert(!capture_recording());
+
+  struct capture_chunk chunk;
+  ck_assert(capture_next_chunk(&chunk));
+  ck_assert_int_eq(chunk.cycles, 2);
+  ck_assert_int_eq(chunk.offset, 0);
+  ck_assert_int_eq(chunk.total, 5 * 3 * sizeof(uint16_t));
+  ck_assert_int_eq(chunk.length, chunk.total);
+
+  const uint16_t *records = (const uint16_t *)chunk.data;
+  ck_assert_int_eq(records[0], 105);
+  ck_assert_int_eq(records[1], 100);
+  ck_assert_int_eq(records[2], 200);
+  ck_assert_int_eq(records[3], 90);
+  ck_assert_int_eq(records[12], 6500);
+
+  /* Everything has been sent */
+  ck_assert(!capture_next_chunk(&chunk));
+}
+END_TEST
+
+START_TEST(check_capture_chunks) {
+  config.decoder.valid = 1;
+  config.decoder.rpm = 0;
+  config.sensors[SENSOR_MAP].source = SENSOR_ADC;
+
+  ck_assert(capture_start(1 << SENSOR_MAP, 1000));
+  capture_at_angle(700);
+  capture_at_angle(1);
+  while (capture_recording()) {
+    capture_at_angle(2);
+  }
+
+  /* A full buffer ends the capture */
+  uint32_t expected_offset = 0;
+  struct capture_chunk chunk;
+  while (capture_next_chunk(&chunk)) {
+    ck_assert_int_eq(chunk.offset, expected_offset);
+    ck_assert_int_le(chunk.length, CAPTURE_CHUNK_SIZE);
+    ck_assert_int_eq(chunk.cycles, 0);
+    expected_offset += chunk.length;
+  }
+  ck_assert_int_eq(expected_offset, CAPTURE_BUFFER_SIZE);
+}
+END_TEST
+
+START_TEST(check_capture_sync_loss) {
+  config.decoder.valid = 1;
+  config.decoder.rpm = 0;
+  config.sensors[SENSOR_MAP].source = SENSOR_ADC;
+  config.sensors[SENSOR_IAT].source = SENSOR_FREQ;
+
+  /* Only ADC sensors can be captured */
+  ck_assert(!capture_start(1 << SENSOR_IAT, 1));
+
+  ck_assert(capture_start(1 << SENSOR_MAP, 1));
+  capture_at_angle(700);
+  capture_at_angle(1);
+  capture_at_angle(2);
+
+  config.decoder.valid = 0;
+  capture_at_angle(3);
+  ck_assert(!capture_recording());
+
+  struct capture_chunk chunk;
+  ck_assert(capture_next_chunk(&chunk));
+  ck_assert_int_eq(chunk.total, 2 * 2 * sizeof(uint16_t));
+  ck_assert_int_eq(chunk.cycles, 0);
+
+  /* Without sync a capture stays armed until cancelled */
+  config.decoder.valid = 1;
+  ck_assert(capture_start(1 << SENSOR_MAP, 1));
+  config.decoder.valid = 0;
+  capture_at_angle(3);
+  ck_assert(capture_recording());
+  capture_cancel();
+  ck_assert(!capture_recording());
+  ck_assert(!capture_next_chunk(&chunk));
+}
+END_TEST
+
+TCase *setup_capture_tests() {
+  TCase *tc = tcase_create("capture");
+  tcase_add_test(tc, check_capture_records_cycles);
+  tcase_add_test(tc, check_capture_chunks);
+  tcase_add_test(tc, check_capture_sync_loss);
+  return tc;
+}
+#endif
@@ -0,0 +1,52 @@
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Preallocated space for raw ADC samples recorded during a capture. Each
+ * record is 2 bytes of angle and 2 per sensor, so with one sensor at the
+ * STM32F4's ADC rate of about 5 kHz this holds about 0.8 seconds: 6 engine
+ * cycles at 1000 rpm, or 40 at 6000 rpm. It is placed in the STM32F4's CCM
+ * RAM, which nothing else uses, so it doesn't count against main RAM */
+#define CAPTURE_BUFFER_SIZE 16384
+
+/* Largest amount of captured data sent in a single console message */
+#define CAPTURE_CHUNK_SIZE 256
+
+/* A portion of a finished capture. Data is a sequence of records, each a
+ * uint16 crank angle in tenths of a degree followed by a uint16 raw value for
+ * each captured sensor in sensor order, all little endian */
+struct capture_chunk {
+  uint32_t sensors; /* Bitmask of sensor_input_type */
+  uint32_t cycles;  /* Complete engine cycles recorded */
+  uint32_t offset;
+  uint32_t total;
+  const uint8_t *data;
+  uint32_t length;
+};
+
+/* Starts recording the raw value of every ADC sample of the given sensors
+ * for a number of engine cycles, beginning at the next cycle. Any previous
+ * capture is discarded. Returns false if any sensor is not an ADC input, or no
+ * cycles are requested */
+bool capture_start(uint32_t sensors, uint32_t cycles);
+void capture_cancel();
+
+/* Whether a capture is waiting for or recording samples */
+bool capture_recording();
+
+/* Called after each set of ADC samples */
+void capture_record();
+
+/* Once recording has finished, provides the next chunk to be sent. Returns
+ * false if there is nothing to send. A capture that recorded nothing is still
+ * sent as a single empty chunk */
+bool capture_next_chunk(struct capture_chunk *);
+
+#ifdef UNITTEST
+#include <check.h>
+TCase *setup_capture_tests();
+#endif
+
+#endif
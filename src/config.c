@@ -1,8 +1,23 @@
 #include "config.h"
 #include "sensors.h"
 
+#ifdef FIXED_POINT_CALCULATIONS
+/* Fixed point copies of the tables read by the fixed point calculations.
+ * These are filled by table_valid(), and aren't stored with the config */
+static struct table_fixed enrich_vs_temp_and_map_fixed;
+static struct table_fixed dwell_ms_vs_brv_fixed;
+static struct table_fixed ve_vs_rpm_and_map_fixed;
+static struct table_fixed lambda_vs_rpm_and_map_fixed;
+static struct table_fixed timing_vs_rpm_and_map_fixed;
+static struct table_fixed spark_trim_vs_rpm_and_map_fixed;
+static struct table_fixed fuel_trim_vs_rpm_and_map_fixed;
+#endif
+
 struct table enrich_vs_temp_and_map __attribute__((section(".configdata"))) = {
   .title = "temp_enrich", .num_axis = 2,
+#ifdef FIXED_POINT_CALCULATIONS
+  .fixed = &enrich_vs_temp_and_map_fixed,
+#endif
   .axis = { { 
       .name = "TEMP", .num = 6,
       .values = {-20, 0, 20, 40, 102, 120},
@@ -57,6 +72,9 @@ struct table tipin_duration_vs_rpm __attribute__((section(".configdata"))) = {
 
 struct table dwell_ms_vs_brv __attribute__((section(".configdata"))) = {
   .title = "dwell", .num_axis = 1,
+#ifdef FIXED_POINT_CALCULATIONS
+  .fixed = &dwell_ms_vs_brv_fixed,
+#endif
   .axis = { { 
       .name = "BRV", .num = 4,
       .values = {5, 10, 14, 18},
@@ -69,6 +87,9 @@ struct table dwell_ms_vs_brv __attribute__((section(".configdata"))) = {
 
 struct table ve_vs_rpm_and_map __attribute__((section(".configdata"))) = {
   .title = "ve", .num_axis = 2,
+#ifdef FIXED_POINT_CALCULATIONS
+  .fixed = &ve_vs_rpm_and_map_fixed,
+#endif
   .axis = { { 
       .name = "RPM", .num = 16,
       .values = {250, 500, 900, 1200, 1600, 2000, 2400, 3000, 3600, 4000, 4400, 5200, 5800, 6400, 6800, 7200},
@@ -102,6 +123,9 @@ struct table ve_vs_rpm_and_map __attribute__((section(".configdata"))) = {
 
 struct table lambda_vs_rpm_and_map __attribute__((section(".configdata"))) = {
   .title = "lambda", .num_axis = 2,
+#ifdef FIXED_POINT_CALCULATIONS
+  .fixed = &lambda_vs_rpm_and_map_fixed,
+#endif
   .axis = { { 
       .name = "RPM", .num = 16,
       .values = {250, 500, 900, 1200, 1600, 2000, 2400, 3000, 3600, 4000, 4400, 5200, 5800, 6400, 6800, 7200},
@@ -134,6 +158,9 @@ struct table lambda_vs_rpm_and_map __attribute__((section(".configdata"))) = {
 
 struct table timing_vs_rpm_and_map __attribute__((section(".configdata"))) = {
   .title = "Timing", .num_axis = 2,
+#ifdef FIXED_POINT_CALCULATIONS
+  .fixed = &timing_vs_rpm_and_map_fixed,
+#endif
   .axis = {
     { .name = "RPM", .num = 16,
       .values = {250, 500, 900, 1200, 1600, 2000, 2400, 3000, 3600, 4000, 4400, 5200, 5800, 6400, 6800, 7200},
@@ -189,6 +216,41 @@ struct table boost_control_pwm __attribute__((section(".configdata"))) = {
   },
 };
 
+/* Layers of the cylinder trim tables are cylinders 0-7 */
+struct table spark_trim_vs_rpm_and_map __attribute__((section(".configdata"))) = {
+  .title = "cylinder_spark_trim", .num_axis = 3,
+#ifdef FIXED_POINT_CALCULATIONS
+  .fixed = &spark_trim_vs_rpm_and_map_fixed,
+#endif
+  .axis = { { .name = "RPM", .num = 2,
+      .values = {1000, 6000},
+    },
+    { .name = "MAP", .num = 2,
+      .values = {20, 240},
+    },
+    { .name = "CYL", .num = 8,
+      .values = {0, 1, 2, 3, 4, 5, 6, 7},
+    },
+  },
+};
+
+struct table fuel_trim_vs_rpm_and_map __attribute__((section(".configdata"))) = {
+  .title = "cylinder_fuel_trim", .num_axis = 3,
+#ifdef FIXED_POINT_CALCULATIONS
+  .fixed = &fuel_trim_vs_rpm_and_map_fixed,
+#endif
+  .axis = { { .name = "RPM", .num = 2,
+      .values = {1000, 6000},
+    },
+    { .name = "MAP", .num = 2,
+      .values = {20, 240},
+    },
+    { .name = "CYL", .num = 8,
+      .values = {0, 1, 2, 3, 4, 5, 6, 7},
+    },
+  },
+};
+
 struct config config __attribute__((section(".configdata"))) = {
   .events = {
     {.type=IGNITION_EVENT, .angle=0, .pin=0},
@@ -211,8 +273,10 @@ struct config config __attribute__((section(".configdata"))) = {
   .freq_inputs = {
     [0] = {.edge = RISING_EDGE, .type = TRIGGER},
     [1] = {.edge = RISING_EDGE, .type = TRIGGER},
-    [2] = {.edge = RISING_EDGE, .type = FREQ},
-    [3] = {.edge = RISING_EDGE, .type = FREQ},
+    [2] = {.edge = RISING_EDGE, .type = FREQ, .average_edges = 4,
+      .timeout_us = 500000},
+    [3] = {.edge = RISING_EDGE, .type = FREQ, .average_edges = 4,
+      .timeout_us = 500000},
   },
   .sensors = {
     [SENSOR_BRV] = {.pin=0, .source=SENSOR_ADC, .method=METHOD_LINEAR,
@@ -220,6 +284,7 @@ struct config config __attribute__((section(".configdata"))) = {
       .fault_config={.min = 100, .max = 4000, .fault_value = 13.8}},
     [SENSOR_IAT] = {.pin=1, .source=SENSOR_ADC, .method=METHOD_THERM,
       .fault_config={.min = 2, .max = 4095, .fault_value = 10.0},
+      .decimation=64,
       .therm={
         .bias=2490,
         .a=0.00146167419060305,
@@ -228,6 +293,7 @@ struct config config __attribute__((section(".configdata"))) = {
       }},
     [SENSOR_CLT] = {.pin=2, .source=SENSOR_ADC, .method=METHOD_THERM,
       .fault_config={.min = 2, .max = 4095, .fault_value = 50.0},
+      .decimation=64,
       .therm={
         .bias=2490,
         .a=0.00131586818223649,
@@ -260,6 +326,8 @@ struct config config __attribute__((section(".configdata"))) = {
   .tipin_enrich_amount = &tipin_vs_tpsrate_and_tps,
   .tipin_enrich_duration = &tipin_duration_vs_rpm,
   .dwell = &dwell_ms_vs_brv,
+  .cylinder_spark_trim = &spark_trim_vs_rpm_and_map,
+  .cylinder_fuel_trim = &fuel_trim_vs_rpm_and_map,
   .rpm_stop = 6700,
   .rpm_start = 6200,
   .fueling = {
@@ -280,6 +348,18 @@ struct config config __attribute__((section(".configdata"))) = {
     .dwell = DWELL_BRV,
     .min_fire_time_us = 500,
   },
+  .calculations = {
+    .input_epsilon = {
+      [CALC_INPUT_RPM] = 5.0,
+      [CALC_INPUT_MAP] = 0.2,
+      [CALC_INPUT_IAT] = 0.2,
+      [CALC_INPUT_CLT] = 0.2,
+      [CALC_INPUT_BRV] = 0.02,
+      [CALC_INPUT_FRT] = 0.2,
+    },
+    .slow_interval_us = 20000,
+    .main_loop_interval_us = 1000,
+  },
   .boost_control = {
     .pwm_duty_vs_rpm = &boost_control_pwm,
     .threshhold_kpa = 130.0,
@@ -291,34 +371,103 @@ struct config config __attribute__((section(".configdata"))) = {
     .lean_boost_kpa = 140.0,
     .lean_boost_ego = .91,
   },
+  .knock = {
+    .enabled = 0,
+    .pin = 8,
+    .sample_rate = 50000,
+    .frequency = 6500,
+    .window_offset = 10,
+    .window_width = 60,
+    .threshold = 4.0,
+    .background_weight = 0.05,
+    .retard_step = 2.0,
+    .retard_max = 8.0,
+    .recovery = 0.1,
+  },
 };
 
-int config_valid() {
-  if (config.ve && !table_valid(config.ve)) {
-    return 0;
-  }
+/* Axes each table may have, as required by the lookups that read it */
+static const struct {
+  struct table **table;
+  uint32_t min_axis;
+  uint32_t max_axis;
+} config_table_roles[] = {
+  { &config.ve, 2, 3 },
+  { &config.timing, 2, 3 },
+  { &config.injector_pw_compensation, 1, 1 },
+  { &config.commanded_lambda, 2, 3 },
+  { &config.tipin_enrich_amount, 2, 2 },
+  { &config.tipin_enrich_duration, 1, 1 },
+  { &config.engine_temp_enrich, 2, 2 },
+  { &config.dwell, 1, 1 },
+  { &config.cylinder_spark_trim, 3, 3 },
+  { &config.cylinder_fuel_trim, 3, 3 },
+  { &config.boost_control.pwm_duty_vs_rpm, 1, 1 },
+};
+
+#define NUM_CONFIG_TABLE_ROLES                                                 \
+  (sizeof(config_table_roles) / sizeof(config_table_roles[0]))
 
-  if (config.timing && !table_valid(config.timing)) {
-    return 0;
+bool config_table_axes_valid(const struct table *role, const struct table *t) {
+  for (unsigned int i = 0; i < NUM_CONFIG_TABLE_ROLES; i++) {
+    if (*config_table_roles[i].table == role) {
+      return (t->num_axis >= config_table_roles[i].min_axis) &&
+             (t->num_axis <= config_table_roles[i].max_axis);
+    }
   }
+  return true;
+}
 
-  if (config.injector_pw_compensation &&
-      !table_valid(config.injector_pw_compensation)) {
-    return 0;
+/* Parts of the config found invalid when last validated: a bit for each
+ * table role, then one for the events. Nothing is valid until validated */
+#define CONFIG_EVENTS_INVALID (1u << NUM_CONFIG_TABLE_ROLES)
+static uint32_t invalid_parts = ~0u;
+
+static bool config_role_valid(unsigned int role) {
+  /* Validating a table also populates the cached parameters used by the
+   * unchecked lookups */
+  struct table *t = *config_table_roles[role].table;
+  return !t || (table_valid(t) && config_table_axes_valid(t, t));
+}
+
+static bool config_events_valid() {
+  for (int i = 0; i < MAX_EVENTS; i++) {
+    if (config.events[i].cylinder >= MAX_CYLINDERS) {
+      return false;
+    }
   }
+  return true;
+}
 
-  if (config.commanded_lambda && !table_valid(config.commanded_lambda)) {
-    return 0;
+static void config_mark_valid(uint32_t part, bool valid) {
+  if (valid) {
+    invalid_parts &= ~part;
+  } else {
+    invalid_parts |= part;
   }
+}
 
-  if (config.tipin_enrich_amount && !table_valid(config.tipin_enrich_amount)) {
-    return 0;
+int config_valid() {
+  invalid_parts = 0;
+  for (unsigned int i = 0; i < NUM_CONFIG_TABLE_ROLES; i++) {
+    config_mark_valid(1u << i, config_role_valid(i));
   }
+  config_mark_valid(CONFIG_EVENTS_INVALID, config_events_valid());
+  return config_is_valid();
+}
 
-  if (config.tipin_enrich_duration &&
-      !table_valid(config.tipin_enrich_duration)) {
-    return 0;
+void config_revalidate_table(const struct table *t) {
+  for (unsigned int i = 0; i < NUM_CONFIG_TABLE_ROLES; i++) {
+    if (*config_table_roles[i].table == t) {
+      config_mark_valid(1u << i, config_role_valid(i));
+    }
   }
+}
+
+void config_revalidate_events() {
+  config_mark_valid(CONFIG_EVENTS_INVALID, config_events_valid());
+}
 
-  return 1;
+bool config_is_valid() {
+  return invalid_parts == 0;
 }
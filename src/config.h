@@ -4,6 +4,7 @@
 #include "calculations.h"
 #include "console.h"
 #include "decoder.h"
+#include "knock.h"
 #include "platform.h"
 #include "scheduler.h"
 #include "sensors.h"
@@ -24,7 +25,7 @@ struct config {
   struct sensor_input sensors[NUM_SENSORS];
 
   /* Frequency inputs */
-  struct freq_input freq_inputs[4];
+  struct freq_input freq_inputs[NUM_FREQ_INPUTS];
 
   /* Tables */
   struct table *timing;
@@ -35,12 +36,16 @@ struct config {
   struct table *dwell;
   struct table *tipin_enrich_amount;
   struct table *tipin_enrich_duration;
+  struct table *cylinder_spark_trim; /* Degrees of advance added */
+  struct table *cylinder_fuel_trim;  /* Percent of fuel added */
 
   /* Fuel information */
   struct fueling_config fueling;
   struct ignition_config ignition;
+  struct calculation_config calculations;
   struct boost_control_config boost_control;
   struct cel_config cel;
+  struct knock_config knock;
 
   /* Cutoffs */
   unsigned int rpm_stop;
@@ -49,6 +54,17 @@ struct config {
 
 extern struct config config;
 
+/* Validates the whole config, including every table, and records the result.
+ * Outputs are not calculated or scheduled from an invalid config */
 int config_valid();
+/* Revalidate only the table t, or only the output events, after a change to
+ * them. Other parts keep the result of their last validation */
+void config_revalidate_table(const struct table *t);
+void config_revalidate_events();
+/* Whether every part of the config was valid when last validated */
+bool config_is_valid();
+/* Whether t, or a staged change to it, has a number of axes accepted by the
+ * lookups of the config table at role. Other tables may have any */
+bool config_table_axes_valid(const struct table *role, const struct table *t);
 
 #endif
@@ -10,9 +10,11 @@
 #include <strings.h>
 
 #include "calculations.h"
+#include "capture.h"
 #include "config.h"
 #include "console.h"
 #include "decoder.h"
+#include "knock.h"
 #include "platform.h"
 #include "sensors.h"
 #include "stats.h"
@@ -21,20 +23,25 @@ static uint32_t render_loss_reason() {
   return (uint32_t)config.decoder.loss;
 };
 
+/* Snapshot of the published calculations, taken for each feed line */
+static struct calculated_values feed_values;
+
 const struct console_feed_node console_feed_nodes[] = {
   { .id = "cputime", .uint32_fptr = current_time },
 
   /* Fueling */
-  { .id = "ve", .float_ptr = &calculated_values.ve },
-  { .id = "lambda", .float_ptr = &calculated_values.lambda },
-  { .id = "fuel_pulsewidth_us", .uint32_ptr = &calculated_values.fueling_us },
-  { .id = "temp_enrich_percent", .float_ptr = &calculated_values.ete },
-  { .id = "injector_dead_time", .float_ptr = &calculated_values.idt },
-  { .id = "accel_enrich_percent", .float_ptr = &calculated_values.tipin },
+  { .id = "ve", .float_ptr = &feed_values.ve },
+  { .id = "lambda", .float_ptr = &feed_values.lambda },
+  { .id = "fuel_pulsewidth_us", .uint32_ptr = &feed_values.fueling_us },
+  { .id = "temp_enrich_percent", .float_ptr = &feed_values.ete },
+  { .id = "injector_dead_time", .float_ptr = &feed_values.idt },
+  { .id = "accel_enrich_percent", .float_ptr = &feed_values.tipin },
 
   /* Ignition */
-  { .id = "advance", .float_ptr = &calculated_values.timing_advance },
-  { .id = "dwell", .uint32_ptr = &calculated_values.dwell_us },
+  { .id = "advance", .float_ptr = &feed_values.timing_advance },
+  { .id = "dwell", .uint32_ptr = &feed_values.dwell_us },
+  { .id = "knock_retard", .float_fptr = knock_max_retard },
+  { .id = "knock_count", .uint32_fptr = knock_count },
 
   { .id = "sensor.map",
     .float_ptr = &config.sensors[SENSOR_MAP].processed_value },
@@ -74,21 +81,42 @@ const struct console_feed_node console_feed_nodes[] = {
 static const char *git_describe = GIT_DESCRIBE;
 #endif
 
+/* Events logged from interrupts, a power of two */
+#define EVENT_LOG_SIZE 512
+
+/* Most events encoded in a single events message */
+#define EVENT_LOG_BATCH 16
+
+/* Each event is at most 11 bytes, plus the message's other fields */
+#define EVENT_MESSAGE_MAX_SIZE (EVENT_LOG_BATCH * 11 + 64)
+
+/* Events are recorded from several interrupts that may preempt each other, so
+ * producers claim a slot by compare and swap, and mark it complete with its
+ * sequence once written. The console is the only consumer */
 static struct {
   uint32_t enabled;
-  struct logged_event events[32];
+  struct {
+    struct logged_event event;
+    volatile uint32_t sequence; /* Claiming write index plus one once written */
+  } slots[EVENT_LOG_SIZE];
   volatile uint32_t read;
   volatile uint32_t write;
+  volatile uint32_t dropped; /* Events lost to a full log */
 } event_log;
 
-static struct logged_event get_logged_event() {
-  if (!event_log.enabled || (event_log.read == event_log.write)) {
-    return (struct logged_event){ .type = EVENT_NONE };
+static bool get_logged_event(struct logged_event *ev) {
+  if (!event_log.enabled) {
+    return false;
+  }
+  uint32_t read = event_log.read;
+  if (event_log.slots[read % EVENT_LOG_SIZE].sequence != read + 1) {
+    return false;
   }
-  struct logged_event ret = event_log.events[event_log.read];
-  event_log.read = (event_log.read + 1) %
-                   (sizeof(event_log.events) / sizeof(event_log.events[0]));
-  return ret;
+  *ev = event_log.slots[read % EVENT_LOG_SIZE].event;
+  /* The slot must be read before it can be reused */
+  __sync_synchronize();
+  event_log.read = read + 1;
+  return true;
 }
 
 void console_record_event(struct logged_event ev) {
@@ -96,64 +124,59 @@ void console_record_event(struct logged_event ev) {
     return;
   }
 
-  int size = (sizeof(event_log.events) / sizeof(event_log.events[0]));
-  if ((event_log.write + 1) % size == event_log.read) {
-    return;
-  }
+  uint32_t write;
+  do {
+    write = event_log.write;
+    if (write - event_log.read >= EVENT_LOG_SIZE) {
+      __sync_fetch_and_add(&event_log.dropped, 1);
+      return;
+    }
+  } while (!__sync_bool_compare_and_swap(&event_log.write, write, write + 1));
 
-  event_log.events[event_log.write] = ev;
-  event_log.write = (event_log.write + 1) % size;
+  event_log.slots[write % EVENT_LOG_SIZE].event = ev;
+  __sync_synchronize();
+  event_log.slots[write % EVENT_LOG_SIZE].sequence = write + 1;
 }
 
-static size_t console_event_message(uint8_t *dest,
-                                    size_t bsize,
-                                    struct logged_event *ev) {
-  CborEncoder encoder;
-
-  cbor_encoder_init(&encoder, dest, bsize, 0);
+/* Encodes up to EVENT_LOG_BATCH logged events as a single message, each as
+ * its time relative to the previous event, its type, and its value. Returns
+ * false if there are no events */
+static bool console_event_message(CborEncoder *encoder) {
+  struct logged_event ev;
+  if (!get_logged_event(&ev)) {
+    return false;
+  }
 
   CborEncoder top_encoder;
-  cbor_encoder_create_map(&encoder, &top_encoder, 3);
+  cbor_encoder_create_map(encoder, &top_encoder, 4);
   cbor_encode_text_stringz(&top_encoder, "type");
-  cbor_encode_text_stringz(&top_encoder, "event");
+  cbor_encode_text_stringz(&top_encoder, "events");
 
   cbor_encode_text_stringz(&top_encoder, "time");
-  cbor_encode_int(&top_encoder, ev->time);
+  cbor_encode_uint(&top_encoder, ev.time);
 
-  cbor_encode_text_stringz(&top_encoder, "event");
+  cbor_encode_text_stringz(&top_encoder, "dropped");
+  cbor_encode_uint(&top_encoder, event_log.dropped);
 
-  CborEncoder event_encoder;
+  cbor_encode_text_stringz(&top_encoder, "events");
+  CborEncoder event_list_encoder;
+  cbor_encoder_create_array(
+    &top_encoder, &event_list_encoder, CborIndefiniteLength);
 
-  switch (ev->type) {
-  case EVENT_OUTPUT:
-    cbor_encoder_create_map(&top_encoder, &event_encoder, 2);
-    cbor_encode_text_stringz(&event_encoder, "type");
-    cbor_encode_text_stringz(&event_encoder, "output");
-    cbor_encode_text_stringz(&event_encoder, "outputs");
-    cbor_encode_int(&event_encoder, ev->value);
-    cbor_encoder_close_container(&top_encoder, &event_encoder);
-    break;
-  case EVENT_GPIO:
-    cbor_encoder_create_map(&top_encoder, &event_encoder, 2);
-    cbor_encode_text_stringz(&event_encoder, "type");
-    cbor_encode_text_stringz(&event_encoder, "gpio");
-    cbor_encode_text_stringz(&event_encoder, "outputs");
-    cbor_encode_int(&event_encoder, ev->value);
-    cbor_encoder_close_container(&top_encoder, &event_encoder);
-    break;
-  case EVENT_TRIGGER:
-    cbor_encoder_create_map(&top_encoder, &event_encoder, 2);
-    cbor_encode_text_stringz(&event_encoder, "type");
-    cbor_encode_text_stringz(&event_encoder, "trigger");
-    cbor_encode_text_stringz(&event_encoder, "pin");
-    cbor_encode_int(&event_encoder, ev->value);
-    cbor_encoder_close_container(&top_encoder, &event_encoder);
-    break;
-  default:
-    break;
-  }
-  cbor_encoder_close_container(&encoder, &top_encoder);
-  return cbor_encoder_get_buffer_size(&encoder, dest);
+  timeval_t last_time = ev.time;
+  int n_events = 0;
+  do {
+    /* Events from different interrupts may be slightly out of order */
+    cbor_encode_int(&event_list_encoder, (int32_t)(ev.time - last_time));
+    cbor_encode_uint(&event_list_encoder, ev.type);
+    cbor_encode_uint(&event_list_encoder, ev.value);
+    last_time = ev.time;
+    n_events++;
+  } while ((n_events < EVENT_LOG_BATCH) && get_logged_event(&ev));
+
+  cbor_encoder_close_container(&top_encoder, &event_list_encoder);
+  cbor_encoder_close_container(encoder, &top_encoder);
+  return true;
 }
 
 void render_type_field(CborEncoder *enc, const char *type) {
@@ -204,12 +227,9 @@ static bool console_string_matches(CborValue *val, const char *str) {
   return match;
 }
 
-static size_t console_feed_line_keys(uint8_t *dest, size_t bsize) {
-  CborEncoder encoder;
-  cbor_encoder_init(&encoder, dest, bsize, 0);
-
+static void console_feed_line_keys(CborEncoder *encoder) {
   CborEncoder top_encoder;
-  cbor_encoder_create_map(&encoder, &top_encoder, 2);
+  cbor_encoder_create_map(encoder, &top_encoder, 2);
   cbor_encode_text_stringz(&top_encoder, "type");
   cbor_encode_text_stringz(&top_encoder, "description");
 
@@ -223,58 +243,277 @@ static size_t console_feed_line_keys(uint8_t *dest, size_t bsize) {
     cbor_encode_text_stringz(&key_list_encoder, node->id);
   }
   cbor_encoder_close_container(&top_encoder, &key_list_encoder);
-  cbor_encoder_close_container(&encoder, &top_encoder);
-  return cbor_encoder_get_buffer_size(&encoder, dest);
+  cbor_encoder_close_container(encoder, &top_encoder);
 }
 
-static size_t console_feed_line(uint8_t *dest, size_t bsize) {
-  CborEncoder encoder;
+/* Most nodes a single feed message can carry, enough for every node so the
+ * full feed always matches the keys described by console_feed_line_keys() */
+#define CONSOLE_FEED_MAX_NODES                                                 \
+  (sizeof(console_feed_nodes) / sizeof(console_feed_nodes[0]) - 1)
+
+/* Each value is an initial byte and a four byte argument */
+#define CONSOLE_FEED_VALUE_SIZE 5
 
-  cbor_encoder_init(&encoder, dest, bsize, 0);
+/* A feed message encoded once with every value a fixed width float32 or
+ * uint32, so each feed line only patches the current values into place */
+struct console_feed_template {
+  uint8_t buf[CONSOLE_FEED_MAX_NODES * CONSOLE_FEED_VALUE_SIZE + 64];
+  size_t len;
+  size_t values_offset;
+  uint32_t n_nodes;
+  const struct console_feed_node *nodes[CONSOLE_FEED_MAX_NODES];
+};
+
+/* Encodes a template for its nodes. Subscription is -1 for the full feed */
+static void console_feed_template_init(struct console_feed_template *t,
+                                       int subscription) {
+  CborEncoder encoder;
+  cbor_encoder_init(&encoder, t->buf, sizeof(t->buf), 0);
 
   CborEncoder top_encoder;
-  cbor_encoder_create_map(&encoder, &top_encoder, 2);
+  cbor_encoder_create_map(&encoder, &top_encoder, subscription < 0 ? 2 : 3);
   cbor_encode_text_stringz(&top_encoder, "type");
   cbor_encode_text_stringz(&top_encoder, "feed");
+  if (subscription >= 0) {
+    cbor_encode_text_stringz(&top_encoder, "subscription");
+    cbor_encode_int(&top_encoder, subscription);
+  }
 
   cbor_encode_text_stringz(&top_encoder, "values");
   CborEncoder value_list_encoder;
-  cbor_encoder_create_array(
-    &top_encoder, &value_list_encoder, CborIndefiniteLength);
-  for (const struct console_feed_node *node = &console_feed_nodes[0];
-       node->id != NULL;
-       node++) {
+  cbor_encoder_create_array(&top_encoder, &value_list_encoder, t->n_nodes);
+  for (uint32_t i = 0; i < t->n_nodes; i++) {
+    cbor_encode_float(&value_list_encoder, 0.0f);
+  }
+  cbor_encoder_close_container(&top_encoder, &value_list_encoder);
+  cbor_encoder_close_container(&encoder, &top_encoder);
+  t->len = cbor_encoder_get_buffer_size(&encoder, t->buf);
+
+  /* Values are the last items of the message, all encoded as floats so far */
+  t->values_offset = t->len - t->n_nodes * CONSOLE_FEED_VALUE_SIZE;
+  for (uint32_t i = 0; i < t->n_nodes; i++) {
+    const struct console_feed_node *node = t->nodes[i];
+    if (!node->float_ptr && !node->float_fptr) {
+      /* Unsigned integer with a four byte argument */
+      t->buf[t->values_offset + i * CONSOLE_FEED_VALUE_SIZE] = 0x1a;
+    }
+  }
+}
+
+static void console_feed_template_patch(struct console_feed_template *t) {
+  calculations_snapshot(&feed_values);
+
+  uint8_t *value = &t->buf[t->values_offset];
+  for (uint32_t i = 0; i < t->n_nodes; i++) {
+    const struct console_feed_node *node = t->nodes[i];
+    uint32_t bits = 0;
     if (node->uint32_ptr) {
-      cbor_encode_uint(&value_list_encoder, *node->uint32_ptr);
+      bits = *node->uint32_ptr;
     } else if (node->float_ptr) {
-      cbor_encode_float(&value_list_encoder, *node->float_ptr);
+      memcpy(&bits, node->float_ptr, sizeof(bits));
     } else if (node->uint32_fptr) {
-      cbor_encode_uint(&value_list_encoder, node->uint32_fptr());
+      bits = node->uint32_fptr();
     } else if (node->float_fptr) {
-      cbor_encode_float(&value_list_encoder, node->float_fptr());
-    } else {
-      cbor_encode_text_stringz(&value_list_encoder, "invalid");
+      float f = node->float_fptr();
+      memcpy(&bits, &f, sizeof(bits));
+    }
+    /* Arguments are big endian */
+    value[1] = bits >> 24;
+    value[2] = bits >> 16;
+    value[3] = bits >> 8;
+    value[4] = bits;
+    value += CONSOLE_FEED_VALUE_SIZE;
+  }
+}
+
+static const struct console_feed_template *console_feed_line() {
+  static struct console_feed_template feed_template;
+  if (!feed_template.len) {
+    for (const struct console_feed_node *node = &console_feed_nodes[0];
+         node->id != NULL;
+         node++) {
+      feed_template.nodes[feed_template.n_nodes] = node;
+      feed_template.n_nodes++;
     }
+    console_feed_template_init(&feed_template, -1);
   }
-  cbor_encoder_close_container(&top_encoder, &value_list_encoder);
-  cbor_encoder_close_container(&encoder, &top_encoder);
-  return cbor_encoder_get_buffer_size(&encoder, dest);
+  console_feed_template_patch(&feed_template);
+  return &feed_template;
+}
+
+/* Clients may subscribe to a subset of the feed nodes at their own interval.
+ * While any subscription is active only subscribed nodes are sent, and the
+ * full feed and its descriptions stop */
+#define CONSOLE_MAX_SUBSCRIPTIONS 4
+
+/* Subscriptions end once the transport has taken nothing from the transmit
+ * queue for this long, as when the client has closed the port or stopped
+ * reading, so that it doesn't leave the next client without the full feed.
+ * Each is reported with an unsubscribed message once the link takes data */
+#define CONSOLE_SUBSCRIPTION_TIMEOUT_US 10000000
+
+static struct console_subscription {
+  bool active;
+  bool expired; /* Ended by the timeout, and not yet reported */
+  uint32_t interval_us;
+  timeval_t last_sent;
+  struct console_feed_template feed;
+} subscriptions[CONSOLE_MAX_SUBSCRIPTIONS];
+
+/* Messages waiting for the transport, a power of two. Messages are encoded
+ * straight into the queue, and feed messages are skipped while the link is
+ * busy. Every message other than a response must fit in it whole */
+#define CONSOLE_TX_SIZE 512
+
+static struct {
+  uint8_t buf[CONSOLE_TX_SIZE];
+  uint32_t head; /* Next byte to send */
+  uint32_t tail; /* Next byte to queue */
+  timeval_t last_progress; /* Last time the queue was sent from, or empty */
+} console_tx;
+
+static size_t console_tx_free() {
+  return CONSOLE_TX_SIZE - (console_tx.tail - console_tx.head);
+}
+
+static bool console_tx_empty() {
+  return console_tx.head == console_tx.tail;
 }
 
-static int console_write_full(const uint8_t *buf, size_t len) {
-  size_t remaining = len;
-  const uint8_t *ptr = buf;
-  while (remaining) {
-    size_t written = console_write(ptr, remaining);
-    if (written > 0) {
-      remaining -= written;
-      ptr += written;
+/* Queues a whole message, or none of it if it doesn't fit */
+static bool console_tx_queue(const uint8_t *buf, size_t len) {
+  if (len > console_tx_free()) {
+    return false;
+  }
+  while (len) {
+    uint32_t offset = console_tx.tail % CONSOLE_TX_SIZE;
+    size_t amt = len;
+    if (amt > CONSOLE_TX_SIZE - offset) {
+      amt = CONSOLE_TX_SIZE - offset;
     }
+    memcpy(&console_tx.buf[offset], buf, amt);
+    console_tx.tail += amt;
+    buf += amt;
+    len -= amt;
+  }
+  return true;
+}
+
+/* Hands queued bytes to the transport until it takes no more */
+static void console_tx_drain() {
+  uint32_t head = console_tx.head;
+  while (!console_tx_empty()) {
+    uint32_t offset = console_tx.head % CONSOLE_TX_SIZE;
+    size_t amt = console_tx.tail - console_tx.head;
+    if (amt > CONSOLE_TX_SIZE - offset) {
+      amt = CONSOLE_TX_SIZE - offset;
+    }
+    size_t written = console_write(&console_tx.buf[offset], amt);
+    if (!written) {
+      break;
+    }
+    console_tx.head += written;
+  }
+
+  /* The link has only stalled if it took nothing while data was waiting */
+  if (console_tx_empty() || (console_tx.head != head)) {
+    console_tx.last_progress = current_time();
   }
-  return 1;
 }
 
-static uint8_t rx_buffer[16384];
+/* Encoder output streamed into the transmit queue. A message that doesn't
+ * fit is removed from the queue entirely */
+struct console_stream {
+  bool failed;
+  uint32_t start; /* Queue tail when the message started */
+};
+
+static CborError console_stream_write(void *token,
+                                      const void *data,
+                                      size_t len,
+                                      CborEncoderAppendType type) {
+  (void)type;
+  struct console_stream *stream = token;
+
+  if (!stream->failed && !console_tx_queue(data, len)) {
+    console_tx.tail = stream->start;
+    stream->failed = true;
+  }
+  return stream->failed ? CborErrorOutOfMemory : CborNoError;
+}
+
+static void console_stream_init(CborEncoder *encoder,
+                                struct console_stream *stream) {
+  *stream = (struct console_stream){
+    .start = console_tx.tail,
+  };
+  cbor_encoder_init_writer(encoder, console_stream_write, stream);
+}
+
+/* Responses are not buffered. Each pass renders the response to the request
+ * at the start of rx_buffer again, skipping the bytes earlier passes queued,
+ * and queues what follows until the transmit queue is full. A response of any
+ * size is sent a queue at a time without stalling the main loop.
+ *
+ * Every pass must render the same bytes. A request's side effects only happen
+ * on the first pass, which waits for room for any response that isn't a get,
+ * set, or structure, and live counters are rendered from a copy taken when the
+ * request is started */
+#define CONSOLE_RESPONSE_MIN_FREE 128
+
+static struct {
+  bool active;
+  bool replay; /* The request has already been carried out */
+  size_t request_len;
+  uint32_t sent;
+  uint32_t recomputes[NUM_CALC_NODES];
+} console_response;
+
+struct console_response_stream {
+  uint32_t offset; /* Position in the rendered response */
+  bool full;
+};
+
+static CborError console_response_write(void *token,
+                                        const void *data,
+                                        size_t len,
+                                        CborEncoderAppendType type) {
+  (void)type;
+  struct console_response_stream *stream = token;
+  const uint8_t *bytes = data;
+
+  if (stream->full) {
+    return CborErrorOutOfMemory;
+  }
+  if (stream->offset < console_response.sent) {
+    size_t skip = console_response.sent - stream->offset;
+    if (skip > len) {
+      skip = len;
+    }
+    stream->offset += skip;
+    bytes += skip;
+    len -= skip;
+  }
+
+  /* Values are queued whole so that each comes from a single pass. Only data
+   * larger than the queue is split */
+  size_t amt = len;
+  if (amt > console_tx_free()) {
+    amt = (len > CONSOLE_TX_SIZE) ? console_tx_free() : 0;
+  }
+  console_tx_queue(bytes, amt);
+  stream->offset += amt;
+  console_response.sent += amt;
+
+  if (amt < len) {
+    stream->full = true;
+    return CborErrorOutOfMemory;
+  }
+  return CborNoError;
+}
+
+/* Large enough for a request setting a table row */
+static uint8_t rx_buffer[512];
 static size_t rx_buffer_size = 0;
 static timeval_t rx_start_time = 0;
 
@@ -476,6 +715,136 @@ void render_custom_map_field(struct console_request_context *ctx,
   }
 }
 
+/* Index of every map and array object in the request tree, so that a get or
+ * set can start rendering at the deepest container on its path rather than
+ * walking the whole tree and comparing the path against every field on the
+ * way. Nodes are found by a hash of their parent node and path segment.
+ *
+ * The index is built once from a structure walk, so containers that appear
+ * in the structure must not depend on config, and must be rendered with
+ * pointers that outlive the walk */
+#define CONSOLE_PATH_INDEX_NODES 128
+#define CONSOLE_PATH_INDEX_SLOTS 256
+#define CONSOLE_PATH_ID_MAX 32
+
+/* What a set below a path index node must revalidate or reconfigure */
+#define CONSOLE_SET_TABLES (1 << 0)
+#define CONSOLE_SET_EVENTS (1 << 1)
+#define CONSOLE_SET_CALCULATIONS (1 << 2)
+#define CONSOLE_SET_SENSORS (1 << 3)
+#define CONSOLE_SET_KNOCK (1 << 4)
+#define CONSOLE_SET_ALL 0x1f
+
+struct console_path_node {
+  int parent;
+  const char *segment_id; /* NULL for an array element */
+  int segment_index;
+  console_renderer rend;
+  void *ptr;
+  bool is_array;
+  uint8_t reconfigure; /* CONSOLE_SET_* */
+};
+
+/* Each top level subtree is used by these subsystems, and any subtree not
+ * listed by all of them */
+static const struct {
+  const char *id;
+  uint8_t reconfigure;
+} console_set_reconfigures[] = {
+  { "decoder", 0 },
+  { "sensors", CONSOLE_SET_SENSORS },
+  { "outputs", CONSOLE_SET_EVENTS | CONSOLE_SET_KNOCK },
+  { "fueling", CONSOLE_SET_CALCULATIONS },
+  { "ignition", CONSOLE_SET_CALCULATIONS },
+  { "calculations", CONSOLE_SET_CALCULATIONS },
+  { "tables", CONSOLE_SET_TABLES | CONSOLE_SET_CALCULATIONS },
+  { "boost-control", CONSOLE_SET_TABLES | CONSOLE_SET_CALCULATIONS },
+  { "check-engine-light", 0 },
+  { "knock", CONSOLE_SET_KNOCK },
+  { "freq", CONSOLE_SET_SENSORS },
+  { "test", 0 },
+  { "info", 0 },
+};
+
+static uint8_t console_set_reconfigure(const char *id) {
+  for (unsigned int i = 0; i < sizeof(console_set_reconfigures) /
+                                   sizeof(console_set_reconfigures[0]);
+       i++) {
+    if (!strcmp(console_set_reconfigures[i].id, id)) {
+      return console_set_reconfigures[i].reconfigure;
+    }
+  }
+  return CONSOLE_SET_ALL;
+}
+
+static struct {
+  bool built;
+  int n_nodes;
+  struct console_path_node nodes[CONSOLE_PATH_INDEX_NODES];
+  uint8_t slots[CONSOLE_PATH_INDEX_SLOTS]; /* Node + 1, or 0 if empty */
+} console_path_index;
+
+/* FNV-1a */
+static uint32_t console_path_hash(int parent,
+                                  const char *id,
+                                  size_t len,
+                                  int index) {
+  uint32_t hash = 2166136261u;
+  hash = (hash ^ (uint32_t)parent) * 16777619u;
+  if (!id) {
+    return (hash ^ (uint32_t)index) * 16777619u;
+  }
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ (uint8_t)id[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static void console_path_index_add(struct console_request_context *ctx,
+                                   console_renderer rend,
+                                   void *ptr,
+                                   bool is_array) {
+  if (console_path_index.n_nodes == CONSOLE_PATH_INDEX_NODES) {
+    /* Out of space, so this subtree is only reached through its parent */
+    ctx->is_indexing = false;
+    return;
+  }
+
+  uint8_t reconfigure = CONSOLE_SET_ALL;
+  if (ctx->node == 0) {
+    reconfigure = console_set_reconfigure(ctx->segment_id);
+  } else if (ctx->node > 0) {
+    reconfigure = console_path_index.nodes[ctx->node].reconfigure;
+  }
+
+  int node = console_path_index.n_nodes;
+  console_path_index.nodes[node] = (struct console_path_node){
+    .parent = ctx->node,
+    .segment_id = ctx->segment_id,
+    .segment_index = ctx->segment_index,
+    .rend = rend,
+    .ptr = ptr,
+    .is_array = is_array,
+    .reconfigure = reconfigure,
+  };
+  console_path_index.n_nodes++;
+  ctx->node = node;
+
+  /* The top level object is the start of every path, and isn't looked up */
+  if (node == 0) {
+    return;
+  }
+
+  const struct console_path_node *n = &console_path_index.nodes[node];
+  const char *id = n->segment_id;
+  uint32_t slot = console_path_hash(
+    n->parent, id, id ? strlen(id) : 0, n->segment_index);
+  while (console_path_index.slots[slot % CONSOLE_PATH_INDEX_SLOTS]) {
+    slot++;
+  }
+  console_path_index.slots[slot % CONSOLE_PATH_INDEX_SLOTS] = node + 1;
+}
+
 bool descend_array_field(struct console_request_context *ctx,
                          struct console_request_context *deeper_ctx,
                          int index) {
@@ -516,6 +885,9 @@ bool descend_array_field(struct console_request_context *ctx,
     }
     return true;
   case CONSOLE_STRUCTURE:
+    deeper_ctx->segment_id = NULL;
+    deeper_ctx->segment_index = index;
+    return true;
   case CONSOLE_DESCRIBE:
     return true;
   }
@@ -536,6 +908,10 @@ void render_array_object(struct console_request_context *ctx,
     ctx->response = &array;
   }
 
+  if (ctx->is_indexing) {
+    console_path_index_add(ctx, rend, ptr, true);
+  }
+
   rend(ctx, ptr);
   if (ctx->is_filtered && !ctx->is_completed) {
     cbor_encode_null(ctx->response);
@@ -581,6 +957,10 @@ void render_map_object(struct console_request_context *ctx,
     ctx->response = &map;
   }
 
+  if (ctx->is_indexing) {
+    console_path_index_add(ctx, rend, ptr, false);
+  }
+
   rend(ctx, ptr);
   if (ctx->is_filtered && !ctx->is_completed) {
     cbor_encode_null(ctx->response);
@@ -634,6 +1014,8 @@ bool descend_map_field(struct console_request_context *ctx,
     }
     return true;
   case CONSOLE_STRUCTURE:
+    deeper_ctx->segment_id = id;
+    /* Intentional fallthrough */
   case CONSOLE_DESCRIBE:
 
     cbor_encode_text_stringz(ctx->response, id);
@@ -798,17 +1180,43 @@ static void render_table_axis(struct console_request_context *ctx, void *_t) {
 
 struct nested_table_context {
   struct table *t;
+  int layer;
   int row;
 };
 
+/* Number of entries along an axis that fit in the table's data storage */
+static int table_axis_len(struct table *t, int axis) {
+  int max = (t->num_axis == 3) ? MAX_3D_AXIS_SIZE : MAX_AXIS_SIZE;
+  return t->axis[axis].num < max ? t->axis[axis].num : max;
+}
+
 static void render_table_second_axis_data(struct console_request_context *ctx,
                                           void *_ntc) {
   struct nested_table_context *ntc = _ntc;
   struct table *t = ntc->t;
-  for (int j = 0; j < t->axis[0].num; j++) {
+  float *row = (t->num_axis == 3) ? t->data.three[ntc->layer][ntc->row]
+                                  : t->data.two[ntc->row];
+  for (int j = 0; j < table_axis_len(t, 0); j++) {
     struct console_request_context deeper;
     if (descend_array_field(ctx, &deeper, j)) {
-      render_float_object(&deeper, "axis value", &t->data.two[ntc->row][j]);
+      render_float_object(&deeper, "axis value", &row[j]);
+    }
+  }
+}
+
+static void render_table_third_axis_data(struct console_request_context *ctx,
+                                         void *_ntc) {
+  struct nested_table_context *ntc = _ntc;
+  struct table *t = ntc->t;
+  for (int i = 0; i < table_axis_len(t, 1); i++) {
+    struct console_request_context deeper;
+    if (descend_array_field(ctx, &deeper, i)) {
+      struct nested_table_context row = {
+        .t = t,
+        .layer = ntc->layer,
+        .row = i,
+      };
+      render_array_object(&deeper, render_table_second_axis_data, &row);
     }
   }
 }
@@ -819,7 +1227,9 @@ static void render_table_data_description(struct console_request_context *ctx,
   CborEncoder desc;
   cbor_encoder_create_map(ctx->response, &desc, 3);
   render_type_field(&desc, "[[float]]");
-  render_description_field(&desc, "list of lists of table values");
+  render_description_field(
+    &desc,
+    "list of lists of table values (nested per layer for three axis tables)");
   cbor_encode_text_stringz(&desc, "len");
   cbor_encode_int(&desc, MAX_AXIS_SIZE);
   cbor_encoder_close_container(ctx->response, &desc);
@@ -828,34 +1238,40 @@ static void render_table_data_description(struct console_request_context *ctx,
 static void render_table_data(struct console_request_context *ctx, void *_t) {
   struct table *t = _t;
   if (t->num_axis == 1) {
-    for (int i = 0; i < t->axis[0].num; i++) {
+    for (int i = 0; i < table_axis_len(t, 0); i++) {
       struct console_request_context deeper;
       if (descend_array_field(ctx, &deeper, i)) {
         render_float_object(&deeper, "axis value", &t->data.one[i]);
       }
     }
   } else if (t->num_axis == 2) {
-    for (int i = 0; i < t->axis[1].num; i++) {
+    for (int i = 0; i < table_axis_len(t, 1); i++) {
       struct console_request_context deeper;
       if (descend_array_field(ctx, &deeper, i)) {
         struct nested_table_context ntc = { .t = t, .row = i };
         render_array_object(&deeper, render_table_second_axis_data, &ntc);
       }
     }
+  } else if (t->num_axis == 3) {
+    for (int i = 0; i < table_axis_len(t, 2); i++) {
+      struct console_request_context deeper;
+      if (descend_array_field(ctx, &deeper, i)) {
+        struct nested_table_context ntc = { .t = t, .layer = i };
+        render_array_object(&deeper, render_table_third_axis_data, &ntc);
+      }
+    }
   }
 }
 
-static void render_table_object(struct console_request_context *ctx, void *_t) {
+static void render_table_fields(struct console_request_context *ctx,
+                                void *_t) {
   struct table *t = _t;
-  if (ctx->type == CONSOLE_STRUCTURE) {
-    render_type_field(ctx->response, "table");
-    return;
-  }
   render_custom_map_field(ctx, "title", render_table_title, t);
   render_uint32_map_field(
-    ctx, "num-axis", "number of axis (1 or 2)", &t->num_axis);
+    ctx, "num-axis", "number of axis (1, 2, or 3)", &t->num_axis);
   render_map_map_field(ctx, "horizontal-axis", render_table_axis, &t->axis[0]);
   render_map_map_field(ctx, "vertical-axis", render_table_axis, &t->axis[1]);
+  render_map_map_field(ctx, "depth-axis", render_table_axis, &t->axis[2]);
 
   if ((ctx->type != CONSOLE_DESCRIBE)) {
     render_array_map_field(ctx, "data", render_table_data, t);
@@ -864,6 +1280,53 @@ static void render_table_object(struct console_request_context *ctx, void *_t) {
   }
 }
 
+static void render_table_object(struct console_request_context *ctx, void *_t) {
+  struct table *t = _t;
+  if (ctx->type == CONSOLE_STRUCTURE) {
+    render_type_field(ctx->response, "table");
+    return;
+  }
+  if (ctx->type != CONSOLE_SET) {
+    render_table_fields(ctx, t);
+    return;
+  }
+
+  /* Apply the set to a copy of the table, and only commit it if the result is
+   * still valid and has the axes its lookups need. Tables are used in the
+   * decoder ISR without further checks. */
+  struct table staged = *t;
+#ifdef FIXED_POINT_CALCULATIONS
+  /* The fixed point copy is in use, so is converted into a staged copy too */
+  struct table_fixed staged_fixed;
+  staged.fixed = t->fixed ? &staged_fixed : NULL;
+#endif
+  CborValue staged_path = *ctx->path;
+  CborEncoder discard;
+  cbor_encoder_init(&discard, NULL, 0, 0);
+
+  struct console_request_context staged_ctx = *ctx;
+  staged_ctx.path = &staged_path;
+  staged_ctx.response = &discard;
+  render_table_fields(&staged_ctx, &staged);
+
+  if (table_valid(&staged) && config_table_axes_valid(t, &staged)) {
+    staged.fixed = t->fixed;
+    disable_interrupts();
+    *t = staged;
+#ifdef FIXED_POINT_CALCULATIONS
+    if (t->fixed) {
+      *t->fixed = staged_fixed;
+    }
+#endif
+    enable_interrupts();
+  }
+
+  /* Respond with the table as committed */
+  ctx->type = CONSOLE_GET;
+  render_table_fields(ctx, t);
+  ctx->type = CONSOLE_SET;
+}
+
 static void render_tables(struct console_request_context *ctx, void *ptr) {
   (void)ptr;
   render_map_map_field(ctx, "ve", render_table_object, config.ve);
@@ -881,6 +1344,12 @@ static void render_tables(struct console_request_context *ctx, void *ptr) {
     ctx, "tipin-amount", render_table_object, config.tipin_enrich_amount);
   render_map_map_field(
     ctx, "tipin-time", render_table_object, config.tipin_enrich_duration);
+  render_map_map_field(ctx,
+                       "cylinder-spark-trim",
+                       render_table_object,
+                       config.cylinder_spark_trim);
+  render_map_map_field(
+    ctx, "cylinder-fuel-trim", render_table_object, config.cylinder_fuel_trim);
 }
 
 static void render_decoder(struct console_request_context *ctx, void *ptr) {
@@ -920,6 +1389,8 @@ static void output_console_renderer(struct console_request_context *ctx,
   render_uint32_map_field(ctx, "inverted", "inverted", &ev->inverted);
   render_float_map_field(
     ctx, "angle", "angle past TDC to trigger event", &ev->angle);
+  render_uint32_map_field(
+    ctx, "cylinder", "cylinder for per-cylinder trims", &ev->cylinder);
 
   int type = ev->type;
   render_enum_map_field(
@@ -979,6 +1450,31 @@ static void render_sensor_object(struct console_request_context *ctx,
   render_uint32_map_field(ctx, "pin", "adc sensor input pin", &input->pin);
   render_float_map_field(
     ctx, "lag", "lag filter coefficient (0-1)", &input->lag);
+  render_uint32_map_field(ctx,
+                          "decimation",
+                          "raw samples averaged per conversion",
+                          &input->decimation);
+
+  int filter = input->filter.type;
+  render_enum_map_field(ctx,
+                        "filter",
+                        "filter over recent samples",
+                        (struct console_enum_mapping[]){
+                          { FILTER_NONE, "none" },
+                          { FILTER_AVERAGE, "average" },
+                          { FILTER_MEDIAN, "median" },
+                          { FILTER_LOWPASS, "lowpass" },
+                          { 0, NULL } },
+                        &filter);
+  input->filter.type = filter;
+  render_uint32_map_field(ctx,
+                          "filter-width",
+                          "samples for average and median filters",
+                          &input->filter.width);
+  render_float_map_field(ctx,
+                         "filter-cutoff",
+                         "lowpass cutoff as a fraction of sample rate",
+                         &input->filter.cutoff);
 
   int source = input->source;
   render_enum_map_field(
@@ -1112,6 +1608,78 @@ static void render_ignition(struct console_request_context *ctx, void *ptr) {
                          &config.ignition.dwell_us);
 }
 
+static void render_calculation_epsilons(struct console_request_context *ctx,
+                                        void *ptr) {
+  (void)ptr;
+  float *eps = config.calculations.input_epsilon;
+  render_float_map_field(
+    ctx, "rpm", "rpm change to recompute", &eps[CALC_INPUT_RPM]);
+  render_float_map_field(
+    ctx, "map", "MAP change (kpa) to recompute", &eps[CALC_INPUT_MAP]);
+  render_float_map_field(
+    ctx, "iat", "IAT change (C) to recompute", &eps[CALC_INPUT_IAT]);
+  render_float_map_field(
+    ctx, "clt", "CLT change (C) to recompute", &eps[CALC_INPUT_CLT]);
+  render_float_map_field(
+    ctx, "brv", "battery voltage change to recompute", &eps[CALC_INPUT_BRV]);
+  render_float_map_field(
+    ctx, "frt", "fuel temp change (C) to recompute", &eps[CALC_INPUT_FRT]);
+}
+
+static void render_calculation_recomputes(struct console_request_context *ctx,
+                                          void *ptr) {
+  (void)ptr;
+  uint32_t *r = console_response.recomputes;
+  render_uint32_map_field(
+    ctx, "timing", "timing recompute count", &r[CALC_NODE_TIMING]);
+  render_uint32_map_field(
+    ctx, "dwell", "dwell recompute count", &r[CALC_NODE_DWELL]);
+  render_uint32_map_field(ctx, "ve", "ve recompute count", &r[CALC_NODE_VE]);
+  render_uint32_map_field(
+    ctx, "lambda", "lambda recompute count", &r[CALC_NODE_LAMBDA]);
+  render_uint32_map_field(
+    ctx, "idt", "injector dead time recompute count", &r[CALC_NODE_IDT]);
+  render_uint32_map_field(
+    ctx, "ete", "temp enrich recompute count", &r[CALC_NODE_ETE]);
+  render_uint32_map_field(ctx,
+                          "air-density",
+                          "air density recompute count",
+                          &r[CALC_NODE_AIR_DENSITY]);
+  render_uint32_map_field(ctx,
+                          "fuel-density",
+                          "fuel density recompute count",
+                          &r[CALC_NODE_FUEL_DENSITY]);
+  render_uint32_map_field(ctx,
+                          "spark-trim",
+                          "cylinder spark trim recompute count",
+                          &r[CALC_NODE_SPARK_TRIM]);
+  render_uint32_map_field(ctx,
+                          "fuel-trim",
+                          "cylinder fuel trim recompute count",
+                          &r[CALC_NODE_FUEL_TRIM]);
+}
+
+static void render_calculations(struct console_request_context *ctx,
+                                void *ptr) {
+  (void)ptr;
+  render_map_map_field(
+    ctx, "input-epsilon", render_calculation_epsilons, NULL);
+  render_uint32_map_field(ctx,
+                          "slow-interval-us",
+                          "period (us) of temperature and voltage terms",
+                          &config.calculations.slow_interval_us);
+  render_uint32_map_field(ctx,
+                          "main-loop",
+                          "calculate in the main loop rather than per trigger",
+                          &config.calculations.main_loop);
+  render_uint32_map_field(ctx,
+                          "main-loop-interval-us",
+                          "minimum period (us) of main loop calculation",
+                          &config.calculations.main_loop_interval_us);
+  render_map_map_field(
+    ctx, "recomputes", render_calculation_recomputes, NULL);
+}
+
 static void render_boost_control(struct console_request_context *ctx,
                                  void *ptr) {
   (void)ptr;
@@ -1143,6 +1711,50 @@ static void render_cel(struct console_request_context *ctx, void *ptr) {
                          &config.cel.lean_boost_ego);
 }
 
+static void render_knock(struct console_request_context *ctx, void *ptr) {
+  (void)ptr;
+  render_uint32_map_field(
+    ctx, "enabled", "retard timing on detected knock", &config.knock.enabled);
+  render_uint32_map_field(
+    ctx, "pin", "ADC pin for knock sensor", &config.knock.pin);
+  render_float_map_field(ctx,
+                         "sample-rate",
+                         "knock sensor samples per second",
+                         &config.knock.sample_rate);
+  render_float_map_field(ctx,
+                         "frequency",
+                         "center of the knock band (Hz)",
+                         &config.knock.frequency);
+  render_uint32_map_field(ctx,
+                          "window-offset",
+                          "start of window after each ignition event (deg)",
+                          &config.knock.window_offset);
+  render_uint32_map_field(ctx,
+                          "window-width",
+                          "width of window (deg)",
+                          &config.knock.window_width);
+  render_float_map_field(ctx,
+                         "threshold",
+                         "ratio of window energy to background that is knock",
+                         &config.knock.threshold);
+  render_float_map_field(ctx,
+                         "background-weight",
+                         "weight of each quiet window in the background",
+                         &config.knock.background_weight);
+  render_float_map_field(ctx,
+                         "retard-step",
+                         "degrees retarded for each knocking window",
+                         &config.knock.retard_step);
+  render_float_map_field(ctx,
+                         "retard-max",
+                         "maximum degrees retarded per cylinder",
+                         &config.knock.retard_max);
+  render_float_map_field(ctx,
+                         "recovery",
+                         "degrees restored for each quiet window",
+                         &config.knock.recovery);
+}
+
 static void render_freq_object(struct console_request_context *ctx, void *ptr) {
   struct freq_input *f = ptr;
 
@@ -1166,13 +1778,22 @@ static void render_freq_object(struct console_request_context *ctx, void *ptr) {
       { FREQ, "freq" }, { TRIGGER, "trigger" }, { 0, NULL } },
     &type);
 
+  render_uint32_map_field(ctx,
+                          "average-edges",
+                          "number of periods averaged for frequency",
+                          &f->average_edges);
+  render_uint32_map_field(ctx,
+                          "timeout",
+                          "time without an edge until frequency is 0 (uS)",
+                          &f->timeout_us);
+
   f->edge = edge;
   f->type = type;
 }
 
 static void render_freq_list(struct console_request_context *ctx, void *ptr) {
   (void)ptr;
-  for (int i = 0; i < 4; i++) {
+  for (int i = 0; i < NUM_FREQ_INPUTS; i++) {
     render_map_array_field(ctx, i, render_freq_object, &config.freq_inputs[i]);
   }
 }
@@ -1231,9 +1852,11 @@ static void console_toplevel_request(struct console_request_context *ctx,
   render_array_map_field(ctx, "outputs", render_outputs, NULL);
   render_map_map_field(ctx, "fueling", render_fueling, NULL);
   render_map_map_field(ctx, "ignition", render_ignition, NULL);
+  render_map_map_field(ctx, "calculations", render_calculations, NULL);
   render_map_map_field(ctx, "tables", render_tables, NULL);
   render_map_map_field(ctx, "boost-control", render_boost_control, NULL);
   render_map_map_field(ctx, "check-engine-light", render_cel, NULL);
+  render_map_map_field(ctx, "knock", render_knock, NULL);
   render_array_map_field(ctx, "freq", render_freq_list, NULL);
   render_map_map_field(ctx, "test", render_test, NULL);
   render_map_map_field(ctx, "info", render_info, NULL);
@@ -1248,6 +1871,87 @@ static void console_toplevel_types(struct console_request_context *ctx,
   render_map_map_field(ctx, "table", render_table_object, config.ve);
 }
 
+static void console_path_index_build() {
+  CborEncoder discard;
+  cbor_encoder_init(&discard, NULL, 0, 0);
+
+  struct console_request_context ctx = {
+    .type = CONSOLE_STRUCTURE,
+    .response = &discard,
+    .is_indexing = true,
+    .node = -1,
+  };
+  render_map_object(&ctx, console_toplevel_request, NULL);
+  console_path_index.built = true;
+}
+
+/* Returns the node reached from parent by a path segment, or -1 */
+static int console_path_index_child(int parent, CborValue *segment) {
+  char id[CONSOLE_PATH_ID_MAX];
+  size_t len = sizeof(id);
+  int index = 0;
+  bool is_id = cbor_value_is_text_string(segment);
+  uint32_t slot;
+
+  if (is_id) {
+    if (cbor_value_copy_text_string(segment, id, &len, NULL) != CborNoError) {
+      return -1;
+    }
+    slot = console_path_hash(parent, id, len, 0);
+  } else if (cbor_value_is_integer(segment) &&
+             (cbor_value_get_int_checked(segment, &index) == CborNoError)) {
+    slot = console_path_hash(parent, NULL, 0, index);
+  } else {
+    return -1;
+  }
+
+  for (; console_path_index.slots[slot % CONSOLE_PATH_INDEX_SLOTS]; slot++) {
+    int node = console_path_index.slots[slot % CONSOLE_PATH_INDEX_SLOTS] - 1;
+    const struct console_path_node *n = &console_path_index.nodes[node];
+    if (n->parent != parent) {
+      continue;
+    }
+    if (is_id && n->segment_id && (strlen(n->segment_id) == len) &&
+        !memcmp(n->segment_id, id, len)) {
+      return node;
+    }
+    if (!is_id && !n->segment_id && (n->segment_index == index)) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+/* Follows the path through the index for as long as it names containers,
+ * leaving it at the first segment that doesn't, and returns the deepest
+ * container reached */
+static const struct console_path_node *console_path_index_find(
+  CborValue *path) {
+  if (!console_path_index.built) {
+    console_path_index_build();
+  }
+
+  int node = 0;
+  while (!cbor_value_at_end(path)) {
+    int child = console_path_index_child(node, path);
+    if (child < 0) {
+      break;
+    }
+    node = child;
+    cbor_value_advance(path);
+  }
+  return &console_path_index.nodes[node];
+}
+
+static void console_path_index_render(struct console_request_context *ctx,
+                                      const struct console_path_node *node) {
+  if (node->is_array) {
+    render_array_object(ctx, node->rend, node->ptr);
+  } else {
+    render_map_object(ctx, node->rend, node->ptr);
+  }
+}
+
 static void console_request_structure(CborEncoder *enc) {
 
   struct console_request_context structure_ctx = {
@@ -1269,6 +1973,7 @@ static void console_request_structure(CborEncoder *enc) {
 }
 
 static void console_request_get(CborEncoder *enc, CborValue *pathlist) {
+  const struct console_path_node *node = console_path_index_find(pathlist);
   struct console_request_context ctx = {
     .type = CONSOLE_GET,
     .response = enc,
@@ -1276,13 +1981,14 @@ static void console_request_get(CborEncoder *enc, CborValue *pathlist) {
     .is_filtered = !cbor_value_at_end(pathlist),
   };
   cbor_encode_text_stringz(enc, "response");
-  render_map_object(&ctx, console_toplevel_request, NULL);
+  console_path_index_render(&ctx, node);
   report_success(enc, true);
 }
 
 static void console_request_set(CborEncoder *enc,
                                 CborValue *pathlist,
                                 CborValue *value) {
+  const struct console_path_node *node = console_path_index_find(pathlist);
   struct console_request_context ctx = {
     .type = CONSOLE_SET,
     .response = enc,
@@ -1291,8 +1997,34 @@ static void console_request_set(CborEncoder *enc,
     .value = *value,
   };
   cbor_encode_text_stringz(enc, "response");
-  render_map_object(&ctx, console_toplevel_request, NULL);
+  console_path_index_render(&ctx, node);
   report_success(enc, true);
+
+  /* Only the subsystems using the subtree set are revalidated or
+   * reconfigured. Setting the same values again to render the rest of a
+   * response changes nothing */
+  if (console_response.replay) {
+    return;
+  }
+  if (node->reconfigure & CONSOLE_SET_TABLES) {
+    if (node->rend == render_table_object) {
+      config_revalidate_table(node->ptr);
+    } else {
+      config_valid();
+    }
+  }
+  if (node->reconfigure & CONSOLE_SET_EVENTS) {
+    config_revalidate_events();
+  }
+  if (node->reconfigure & CONSOLE_SET_CALCULATIONS) {
+    calculations_invalidate();
+  }
+  if (node->reconfigure & CONSOLE_SET_SENSORS) {
+    sensors_reconfigure();
+  }
+  if (node->reconfigure & CONSOLE_SET_KNOCK) {
+    knock_reconfigure();
+  }
 }
 
 static void console_request_flash(CborEncoder *response) {
@@ -1305,7 +2037,126 @@ static void console_request_bootloader(CborEncoder *response) {
   platform_reset_into_bootloader();
 }
 
-static void console_process_request(CborValue *request, CborEncoder *response) {
+static void console_request_capture(CborEncoder *response,
+                                    CborValue *request) {
+  CborValue sensor_list, sensor;
+  cbor_value_map_find_value(request, "sensors", &sensor_list);
+  if (!cbor_value_is_array(&sensor_list)) {
+    report_parsing_error(response, "no 'sensors' provided");
+    return;
+  }
+
+  uint32_t sensors = 0;
+  cbor_value_enter_container(&sensor_list, &sensor);
+  while (!cbor_value_at_end(&sensor)) {
+    int i;
+    for (i = 0; i < NUM_SENSORS; i++) {
+      if (console_string_matches(&sensor, sensor_name_from_type(i))) {
+        sensors |= (1 << i);
+        break;
+      }
+    }
+    if (i == NUM_SENSORS) {
+      report_parsing_error(response, "invalid sensor");
+      return;
+    }
+    cbor_value_advance(&sensor);
+  }
+
+  CborValue cycles_value;
+  cbor_value_map_find_value(request, "cycles", &cycles_value);
+  int cycles;
+  if (!cbor_value_is_integer(&cycles_value) ||
+      (cbor_value_get_int_checked(&cycles_value, &cycles) != CborNoError) ||
+      (cycles <= 0)) {
+    report_parsing_error(response, "invalid 'cycles' provided");
+    return;
+  }
+
+  report_success(response, capture_start(sensors, cycles));
+}
+
+static void console_request_subscribe(CborEncoder *response,
+                                      CborValue *request) {
+  struct console_subscription sub = { .active = true };
+
+  CborValue key_list, key;
+  cbor_value_map_find_value(request, "keys", &key_list);
+  if (!cbor_value_is_array(&key_list)) {
+    report_parsing_error(response, "no 'keys' provided");
+    return;
+  }
+  cbor_value_enter_container(&key_list, &key);
+  while (!cbor_value_at_end(&key)) {
+    int i;
+    for (i = 0; console_feed_nodes[i].id != NULL; i++) {
+      if (console_string_matches(&key, console_feed_nodes[i].id)) {
+        break;
+      }
+    }
+    if (console_feed_nodes[i].id == NULL) {
+      report_parsing_error(response, "invalid key");
+      return;
+    }
+    if (sub.feed.n_nodes == CONSOLE_FEED_MAX_NODES) {
+      report_parsing_error(response, "too many keys");
+      return;
+    }
+    sub.feed.nodes[sub.feed.n_nodes] = &console_feed_nodes[i];
+    sub.feed.n_nodes++;
+    cbor_value_advance(&key);
+  }
+
+  /* Without an interval, subscribed nodes are sent as fast as possible. Up to
+   * a minute keeps the interval within the range of time_diff() */
+  CborValue interval_value;
+  cbor_value_map_find_value(request, "interval", &interval_value);
+  if (cbor_value_is_valid(&interval_value)) {
+    uint64_t interval;
+    if (!cbor_value_is_unsigned_integer(&interval_value) ||
+        (cbor_value_get_uint64(&interval_value, &interval) != CborNoError) ||
+        (interval > 60000000)) {
+      report_parsing_error(response, "invalid 'interval' provided");
+      return;
+    }
+    sub.interval_us = interval;
+  }
+
+  /* An expired subscription keeps its id until its end is reported */
+  for (int id = 0; id < CONSOLE_MAX_SUBSCRIPTIONS; id++) {
+    if (!subscriptions[id].active && !subscriptions[id].expired) {
+      sub.last_sent = current_time();
+      console_feed_template_init(&sub.feed, id);
+      subscriptions[id] = sub;
+      cbor_encode_text_stringz(response, "subscription");
+      cbor_encode_int(response, id);
+      report_success(response, true);
+      return;
+    }
+  }
+  report_parsing_error(response, "no free subscriptions");
+}
+
+static void console_request_unsubscribe(CborEncoder *response,
+                                        CborValue *request) {
+  CborValue id_value;
+  cbor_value_map_find_value(request, "subscription", &id_value);
+  int id;
+  if (!cbor_value_is_integer(&id_value) ||
+      (cbor_value_get_int_checked(&id_value, &id) != CborNoError) ||
+      (id < 0) || (id >= CONSOLE_MAX_SUBSCRIPTIONS) ||
+      (!subscriptions[id].active && !subscriptions[id].expired)) {
+    report_parsing_error(response, "invalid 'subscription' provided");
+    return;
+  }
+  /* A client unsubscribing from an expired subscription already knows */
+  subscriptions[id].active = false;
+  subscriptions[id].expired = false;
+  report_success(response, true);
+}
+
+static void console_response_header(CborValue *request,
+                                    CborEncoder *response) {
   cbor_encode_text_stringz(response, "type");
   cbor_encode_text_stringz(response, "response");
 
@@ -1319,6 +2170,10 @@ static void console_process_request(CborValue *request, CborEncoder *response) {
 
   cbor_encode_text_stringz(response, "id");
   cbor_encode_int(response, req_id);
+}
+
+static void console_process_request(CborValue *request, CborEncoder *response) {
+  console_response_header(request, response);
 
   CborValue request_method_value;
   cbor_value_map_find_value(request, "method", &request_method_value);
@@ -1353,6 +2208,24 @@ static void console_process_request(CborValue *request, CborEncoder *response) {
     return;
   }
 
+  cbor_value_text_string_equals(&request_method_value, "capture", &match);
+  if (match) {
+    console_request_capture(response, request);
+    return;
+  }
+
+  cbor_value_text_string_equals(&request_method_value, "subscribe", &match);
+  if (match) {
+    console_request_subscribe(response, request);
+    return;
+  }
+
+  cbor_value_text_string_equals(&request_method_value, "unsubscribe", &match);
+  if (match) {
+    console_request_unsubscribe(response, request);
+    return;
+  }
+
   CborValue path, pathlist;
   cbor_value_map_find_value(request, "path", &path);
   if (cbor_value_is_array(&path)) {
@@ -1382,67 +2255,173 @@ static void console_process_request(CborValue *request, CborEncoder *response) {
   }
 }
 
-static void console_process_request_raw(int len) {
-  CborParser parser;
-  CborValue value;
-  CborError err;
+/* A chunk of data, plus the sensor names and the message's other fields */
+#define CAPTURE_MESSAGE_MAX_SIZE (CAPTURE_CHUNK_SIZE + 128)
 
-  uint8_t response[16384];
-  CborEncoder encoder;
-
-  cbor_encoder_init(&encoder, response, sizeof(response), 0);
+static void console_capture_message(CborEncoder *encoder,
+                                    struct capture_chunk *chunk) {
+  CborEncoder top_encoder;
+  cbor_encoder_create_map(encoder, &top_encoder, 6);
+  cbor_encode_text_stringz(&top_encoder, "type");
+  cbor_encode_text_stringz(&top_encoder, "capture");
 
-  err = cbor_parser_init(rx_buffer, len, 0, &parser, &value);
-  if (err) {
-    return;
+  cbor_encode_text_stringz(&top_encoder, "sensors");
+  CborEncoder sensor_list_encoder;
+  cbor_encoder_create_array(
+    &top_encoder, &sensor_list_encoder, CborIndefiniteLength);
+  for (int i = 0; i < NUM_SENSORS; i++) {
+    if (chunk->sensors & (1 << i)) {
+      cbor_encode_text_stringz(&sensor_list_encoder, sensor_name_from_type(i));
+    }
   }
+  cbor_encoder_close_container(&top_encoder, &sensor_list_encoder);
 
-  CborEncoder response_map;
-  if (cbor_encoder_create_map(&encoder, &response_map, CborIndefiniteLength) !=
-      CborNoError) {
-    return;
-  }
+  cbor_encode_text_stringz(&top_encoder, "cycles");
+  cbor_encode_uint(&top_encoder, chunk->cycles);
+  cbor_encode_text_stringz(&top_encoder, "offset");
+  cbor_encode_uint(&top_encoder, chunk->offset);
+  cbor_encode_text_stringz(&top_encoder, "total");
+  cbor_encode_uint(&top_encoder, chunk->total);
+  cbor_encode_text_stringz(&top_encoder, "data");
+  cbor_encode_byte_string(&top_encoder, chunk->data, chunk->length);
 
-  console_process_request(&value, &response_map);
+  cbor_encoder_close_container(encoder, &top_encoder);
+}
 
-  if (cbor_encoder_close_container(&encoder, &response_map)) {
-    return;
+static void console_unsubscribed_message(CborEncoder *encoder, int id) {
+  CborEncoder top_encoder;
+  cbor_encoder_create_map(encoder, &top_encoder, 2);
+  cbor_encode_text_stringz(&top_encoder, "type");
+  cbor_encode_text_stringz(&top_encoder, "unsubscribed");
+  cbor_encode_text_stringz(&top_encoder, "subscription");
+  cbor_encode_int(&top_encoder, id);
+  cbor_encoder_close_container(encoder, &top_encoder);
+}
+
+/* Renders a pass of the current response, as described at console_response */
+static void console_response_continue() {
+  CborParser parser;
+  CborValue request;
+  struct console_response_stream stream = { 0 };
+
+  if (cbor_parser_init(rx_buffer,
+                       console_response.request_len,
+                       0,
+                       &parser,
+                       &request) == CborNoError) {
+    CborEncoder encoder;
+    CborEncoder response_map;
+    cbor_encoder_init_writer(&encoder, console_response_write, &stream);
+    cbor_encoder_create_map(&encoder, &response_map, CborIndefiniteLength);
+    console_process_request(&request, &response_map);
+    cbor_encoder_close_container(&encoder, &response_map);
   }
+  console_response.replay = true;
 
-  size_t write_size = cbor_encoder_get_buffer_size(&encoder, response);
-  console_write_full(response, write_size);
+  if (!stream.full) {
+    console_shift_rx_buffer(console_response.request_len);
+    console_response.active = false;
+    console_response.replay = false;
+  }
 }
 
 void console_process() {
   static timeval_t last_desc_time = 0;
-  uint8_t txbuffer[16384];
+  struct console_stream stream;
+  CborEncoder encoder;
 
-  size_t read_size;
-  if ((read_size = console_try_read())) {
-    /* Parse a request from the client */
-    console_process_request_raw(read_size);
-    console_shift_rx_buffer(read_size);
+  console_tx_drain();
+
+  if (!console_response.active) {
+    size_t read_size = console_try_read();
+    if (read_size) {
+      console_response.active = true;
+      console_response.replay = false;
+      console_response.request_len = read_size;
+      console_response.sent = 0;
+      memcpy(console_response.recomputes,
+             calculation_recomputes,
+             sizeof(console_response.recomputes));
+    }
   }
 
-  /* Process any outstanding event messages */
-  struct logged_event ev = get_logged_event();
-  while (ev.type != EVENT_NONE) {
-    size_t write_size = console_event_message(txbuffer, sizeof(txbuffer), &ev);
-    console_write_full(txbuffer, write_size);
-    ev = get_logged_event();
+  /* A request is handled as soon as there is room for a short response,
+   * however busy the link is */
+  if (console_response.active &&
+      (console_response.replay ||
+       (console_tx_free() >= CONSOLE_RESPONSE_MIN_FREE))) {
+    console_response_continue();
+  }
+
+  /* Nothing else may be queued in the middle of a response, and other
+   * messages are held back while a request waits */
+  bool responding = console_response.active;
+
+  /* Process any outstanding events, a batch per message. Events that don't
+   * fit stay in the event log */
+  bool more_events = !responding;
+  while (more_events && (console_tx_free() >= EVENT_MESSAGE_MAX_SIZE)) {
+    console_stream_init(&encoder, &stream);
+    more_events = console_event_message(&encoder);
+  }
+
+  /* Send a finished capture a chunk at a time, between feed messages */
+  struct capture_chunk chunk;
+  if (!responding && (console_tx_free() >= CAPTURE_MESSAGE_MAX_SIZE) &&
+      capture_next_chunk(&chunk)) {
+    console_stream_init(&encoder, &stream);
+    console_capture_message(&encoder, &chunk);
+  }
+
+  /* Send subscriptions that are due. Any subscription replaces the full feed.
+   * One that doesn't fit stays due, and is sent with the latest values once
+   * there is room */
+  bool subscribed = false;
+  bool stalled = time_diff(current_time(), console_tx.last_progress) >
+                 time_from_us(CONSOLE_SUBSCRIPTION_TIMEOUT_US);
+  for (int id = 0; id < CONSOLE_MAX_SUBSCRIPTIONS; id++) {
+    struct console_subscription *sub = &subscriptions[id];
+    if (sub->expired && !responding) {
+      console_stream_init(&encoder, &stream);
+      console_unsubscribed_message(&encoder, id);
+      sub->expired = stream.failed;
+    }
+    if (!sub->active) {
+      continue;
+    }
+    if (stalled) {
+      sub->active = false;
+      sub->expired = true;
+      continue;
+    }
+    subscribed = true;
+    if (responding || (console_tx_free() < sub->feed.len) ||
+        (time_diff(current_time(), sub->last_sent) <
+         time_from_us(sub->interval_us))) {
+      continue;
+    }
+    sub->last_sent = current_time();
+    console_feed_template_patch(&sub->feed);
+    console_tx_queue(sub->feed.buf, sub->feed.len);
+  }
+
+  /* The full feed is only queued once the previous message has been sent, so
+   * it is never stale and its rate follows the link */
+  if (!subscribed && !responding && console_tx_empty()) {
+    /* Has it been 100ms since the last description? */
+    if (time_diff(current_time(), last_desc_time) > time_from_us(100000)) {
+      /* If so, print a description message */
+      console_stream_init(&encoder, &stream);
+      console_feed_line_keys(&encoder);
+      last_desc_time = current_time();
+    } else {
+      /* Otherwise a feed message */
+      const struct console_feed_template *feed = console_feed_line();
+      console_tx_queue(feed->buf, feed->len);
+    }
   }
 
-  /* Has it been 100ms since the last description? */
-  if (time_diff(current_time(), last_desc_time) > time_from_us(100000)) {
-    /* If so, print a description message */
-    size_t write_size = console_feed_line_keys(txbuffer, sizeof(txbuffer));
-    console_write_full(txbuffer, write_size);
-    last_desc_time = current_time();
-  } else {
-    /* Otherwise a feed message */
-    size_t write_size = console_feed_line(txbuffer, sizeof(txbuffer));
-    console_write_full(txbuffer, write_size);
-  }
+  console_tx_drain();
   stats_finish_timing(STATS_CONSOLE_TIME);
 }
 
@@ -1631,6 +2610,665 @@ START_TEST(test_smoke_console_request_get_full) {
 }
 END_TEST
 
+static CborValue render_value_float(uint8_t *buf, size_t len, float v) {
+  CborEncoder enc;
+  CborParser parser;
+  CborValue value;
+  cbor_encoder_init(&enc, buf, len, 0);
+  cbor_encode_float(&enc, v);
+  cbor_parser_init(buf, len, 0, &parser, &value);
+  return value;
+}
+
+START_TEST(test_console_request_set_table) {
+  uint8_t valuebuf[16];
+  CborEncoder set_enc;
+  CborValue value;
+
+  /* A valid change to a data point is applied */
+  render_path("sssuu", "tables", "ve", "data", 0, 1);
+  value = render_value_float(valuebuf, sizeof(valuebuf), 55.0f);
+  cbor_encoder_create_map(&test_ctx.top_encoder, &set_enc, 2);
+  console_request_set(&set_enc, &test_ctx.path_value, &value);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &set_enc);
+  ck_assert_float_eq(config.ve->data.two[0][1], 55.0f);
+  ck_assert(config.ve->valid);
+#ifdef FIXED_POINT_CALCULATIONS
+  ck_assert_int_eq(config.ve->fixed->data.two[0][1], fixed_from_int(55));
+#endif
+
+  /* An axis value that breaks ordering is rejected */
+  float original = config.ve->axis[0].values[0];
+  init_console_tests();
+  render_path("ssssu", "tables", "ve", "horizontal-axis", "values", 0);
+  value = render_value_float(valuebuf, sizeof(valuebuf), 100000.0f);
+  cbor_encoder_create_map(&test_ctx.top_encoder, &set_enc, 2);
+  console_request_set(&set_enc, &test_ctx.path_value, &value);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &set_enc);
+  finish_writing();
+
+  ck_assert_float_eq(config.ve->axis[0].values[0], original);
+  ck_assert(config.ve->valid);
+
+  /* And the response reflects the unchanged table */
+  CborValue response_value;
+  float response;
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "response", &response_value) == CborNoError);
+  ck_assert(cbor_value_get_float(&response_value, &response) == CborNoError);
+  ck_assert_float_eq(response, original);
+
+  /* As is a number of axes that the table's lookups can't use */
+  init_console_tests();
+  render_path("sss", "tables", "ve", "num-axis");
+  CborEncoder value_enc;
+  CborParser value_parser;
+  cbor_encoder_init(&value_enc, valuebuf, sizeof(valuebuf), 0);
+  cbor_encode_uint(&value_enc, 1);
+  cbor_parser_init(valuebuf, sizeof(valuebuf), 0, &value_parser, &value);
+  cbor_encoder_create_map(&test_ctx.top_encoder, &set_enc, 2);
+  console_request_set(&set_enc, &test_ctx.path_value, &value);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &set_enc);
+  finish_writing();
+  ck_assert_int_eq(config.ve->num_axis, 2);
+  ck_assert(config_is_valid());
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "response", &response_value) == CborNoError);
+  uint64_t num_axis;
+  ck_assert(cbor_value_get_uint64(&response_value, &num_axis) == CborNoError);
+  ck_assert_int_eq(num_axis, 2);
+
+  /* And config_valid() rejects such a table however it was changed */
+  config.ve->num_axis = 1;
+  ck_assert(!config_valid());
+
+  /* And accepts it again once only that table is revalidated */
+  config.ve->num_axis = 2;
+  config_revalidate_table(config.ve);
+  ck_assert(config_is_valid());
+}
+END_TEST
+
+START_TEST(test_console_path_index) {
+  /* Lookup stops at the deepest container on the path */
+  render_path("sus", "outputs", 3, "angle");
+  const struct console_path_node *node =
+    console_path_index_find(&test_ctx.path_value);
+  ck_assert(node->ptr == &config.events[3]);
+  ck_assert(console_path_match_str(&test_ctx.path_value, "angle"));
+  ck_assert_int_eq(node->reconfigure, CONSOLE_SET_EVENTS | CONSOLE_SET_KNOCK);
+  ck_assert_int_lt(console_path_index.n_nodes, CONSOLE_PATH_INDEX_NODES);
+
+  render_path("sssuu", "tables", "ve", "data", 0, 1);
+  node = console_path_index_find(&test_ctx.path_value);
+  ck_assert(node->ptr == config.ve);
+  ck_assert(console_path_match_str(&test_ctx.path_value, "data"));
+  ck_assert_int_eq(node->reconfigure,
+                   CONSOLE_SET_TABLES | CONSOLE_SET_CALCULATIONS);
+
+  /* A set with no path reaches every subsystem */
+  render_path("");
+  node = console_path_index_find(&test_ctx.path_value);
+  ck_assert_int_eq(node->reconfigure, CONSOLE_SET_ALL);
+
+  /* Sensors are a map, not an array */
+  render_path("sus", "sensors", 0, "pin");
+  node = console_path_index_find(&test_ctx.path_value);
+  ck_assert_str_eq(node->segment_id, "sensors");
+  ck_assert(console_path_match_int(&test_ctx.path_value, 0));
+
+  /* A set through the index applies and responds as from the top */
+  uint8_t valuebuf[16];
+  CborEncoder enc;
+  CborValue response_value;
+  float response;
+  render_path("sus", "outputs", 3, "angle");
+  CborValue value = render_value_float(valuebuf, sizeof(valuebuf), 45.0f);
+  cbor_encoder_create_map(&test_ctx.top_encoder, &enc, 2);
+  console_request_set(&enc, &test_ctx.path_value, &value);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &enc);
+  finish_writing();
+  ck_assert_float_eq(config.events[3].angle, 45.0f);
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "response", &response_value) == CborNoError);
+  ck_assert(cbor_value_get_float(&response_value, &response) == CborNoError);
+  ck_assert_float_eq(response, 45.0f);
+
+  /* And an unknown field below a container is still null */
+  init_console_tests();
+  render_path("sss", "sensors", "map", "bogus");
+  cbor_encoder_create_map(&test_ctx.top_encoder, &enc, 2);
+  console_request_get(&enc, &test_ctx.path_value);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &enc);
+  finish_writing();
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "response", &response_value) == CborNoError);
+  ck_assert(cbor_value_is_null(&response_value));
+}
+END_TEST
+
+START_TEST(test_console_request_capture) {
+  uint8_t requestbuf[64];
+  CborEncoder enc, request_enc, sensors_enc, response_enc;
+  CborParser parser;
+  CborValue request;
+
+  config.sensors[SENSOR_MAP].source = SENSOR_ADC;
+  config.sensors[SENSOR_MAP].raw_value = 1234;
+  config.decoder.valid = 1;
+  config.decoder.rpm = 0;
+
+  cbor_encoder_init(&enc, requestbuf, sizeof(requestbuf), 0);
+  cbor_encoder_create_map(&enc, &request_enc, 2);
+  cbor_encode_text_stringz(&request_enc, "sensors");
+  cbor_encoder_create_array(&request_enc, &sensors_enc, 1);
+  cbor_encode_text_stringz(&sensors_enc, "map");
+  cbor_encoder_close_container(&request_enc, &sensors_enc);
+  cbor_encode_text_stringz(&request_enc, "cycles");
+  cbor_encode_int(&request_enc, 1);
+  cbor_encoder_close_container(&enc, &request_enc);
+  cbor_parser_init(requestbuf, sizeof(requestbuf), 0, &parser, &request);
+
+  cbor_encoder_create_map(&test_ctx.top_encoder, &response_enc, 1);
+  console_request_capture(&response_enc, &request);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &response_enc);
+  finish_writing();
+
+  CborValue success_value;
+  bool success;
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "success", &success_value) == CborNoError);
+  ck_assert(cbor_value_get_boolean(&success_value, &success) == CborNoError);
+  ck_assert(success);
+
+  /* One sample during a single cycle */
+  config.decoder.last_trigger_angle = 700;
+  capture_record();
+  config.decoder.last_trigger_angle = 10;
+  capture_record();
+  config.decoder.last_trigger_angle = 5;
+  capture_record();
+  config.decoder.last_trigger_angle = 700;
+  capture_record();
+  config.decoder.last_trigger_angle = 0;
+  capture_record();
+
+  struct capture_chunk chunk;
+  ck_assert(capture_next_chunk(&chunk));
+  init_console_tests();
+  console_capture_message(&test_ctx.top_encoder, &chunk);
+  finish_writing();
+
+  CborValue field;
+  uint64_t total;
+  ck_assert(cbor_value_map_find_value(&test_ctx.top_value, "total", &field) ==
+            CborNoError);
+  ck_assert(cbor_value_get_uint64(&field, &total) == CborNoError);
+  ck_assert_int_eq(total, 3 * 2 * sizeof(uint16_t));
+
+  uint16_t data[6];
+  size_t data_len = sizeof(data);
+  ck_assert(cbor_value_map_find_value(&test_ctx.top_value, "data", &field) ==
+            CborNoError);
+  ck_assert(cbor_value_copy_byte_string(
+              &field, (uint8_t *)data, &data_len, NULL) == CborNoError);
+  ck_assert_int_eq(data_len, sizeof(data));
+  ck_assert_int_eq(data[0], 100);
+  ck_assert_int_eq(data[1], 1234);
+  ck_assert_int_eq(data[4], 7000);
+}
+END_TEST
+
+START_TEST(test_console_event_log) {
+  event_log.enabled = 1;
+
+  /* A full log drops new events, and counts them */
+  for (int i = 0; i < EVENT_LOG_SIZE + 3; i++) {
+    console_record_event((struct logged_event){
+      .type = (i % 2) ? EVENT_TRIGGER : EVENT_OUTPUT,
+      .time = 1000 + 10 * i,
+      .value = i % 4,
+    });
+  }
+  ck_assert_int_eq(event_log.dropped, 3);
+
+  ck_assert(console_event_message(&test_ctx.top_encoder));
+  finish_writing();
+
+  CborValue field;
+  uint64_t value;
+  ck_assert(cbor_value_map_find_value(&test_ctx.top_value, "time", &field) ==
+            CborNoError);
+  ck_assert(cbor_value_get_uint64(&field, &value) == CborNoError);
+  ck_assert_int_eq(value, 1000);
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "dropped", &field) == CborNoError);
+  ck_assert(cbor_value_get_uint64(&field, &value) == CborNoError);
+  ck_assert_int_eq(value, 3);
+
+  /* Each event is its time after the previous, type, and value */
+  CborValue events, event;
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "events", &events) == CborNoError);
+  cbor_value_enter_container(&events, &event);
+  int n_events = 0;
+  while (!cbor_value_at_end(&event)) {
+    int delta, type, val;
+    ck_assert(cbor_value_get_int(&event, &delta) == CborNoError);
+    cbor_value_advance(&event);
+    ck_assert(cbor_value_get_int(&event, &type) == CborNoError);
+    cbor_value_advance(&event);
+    ck_assert(cbor_value_get_int(&event, &val) == CborNoError);
+    cbor_value_advance(&event);
+
+    ck_assert_int_eq(delta, n_events ? 10 : 0);
+    ck_assert_int_eq(type, (n_events % 2) ? EVENT_TRIGGER : EVENT_OUTPUT);
+    ck_assert_int_eq(val, n_events % 4);
+    n_events++;
+  }
+  ck_assert_int_eq(n_events, EVENT_LOG_BATCH);
+
+  /* The rest follow in further messages */
+  int n_messages = 1;
+  init_console_tests();
+  while (console_event_message(&test_ctx.top_encoder)) {
+    n_messages++;
+    init_console_tests();
+  }
+  ck_assert_int_eq(n_messages, EVENT_LOG_SIZE / EVENT_LOG_BATCH);
+
+  /* Freed space is reused */
+  console_record_event((struct logged_event){ .type = EVENT_GPIO });
+  init_console_tests();
+  ck_assert(console_event_message(&test_ctx.top_encoder));
+  ck_assert_int_eq(event_log.dropped, 3);
+}
+END_TEST
+
+START_TEST(test_console_process_does_not_block) {
+  /* The test platform's transport never accepts anything */
+  console_process();
+  ck_assert(!console_tx_empty());
+  uint32_t queued = console_tx.tail;
+
+  /* Without room to send, feed messages are skipped rather than queued */
+  console_process();
+  console_process();
+  ck_assert_int_eq(console_tx.tail, queued);
+
+  /* Events still queue while they fit, and otherwise stay logged */
+  console_tx.head = console_tx.tail - 1;
+  event_log.enabled = 1;
+  console_record_event((struct logged_event){ .type = EVENT_TRIGGER });
+  console_process();
+  ck_assert_int_gt(console_tx.tail, queued);
+
+  static uint8_t message[CONSOLE_TX_SIZE];
+  ck_assert(!console_tx_queue(message, console_tx_free() + 1));
+  ck_assert(console_tx_queue(message, console_tx_free()));
+  ck_assert_int_eq(console_tx_free(), 0);
+  console_record_event((struct logged_event){ .type = EVENT_TRIGGER });
+  console_process();
+  ck_assert_int_eq(event_log.read + 1, event_log.write);
+}
+END_TEST
+
+/* Places a request as if it had been received, with a path of the string
+ * arguments up to NULL */
+static void receive_request(int id, const char *method, ...) {
+  CborEncoder enc, request, path;
+  va_list args;
+  cbor_encoder_init(&enc, rx_buffer, sizeof(rx_buffer), 0);
+  cbor_encoder_create_map(&enc, &request, CborIndefiniteLength);
+  cbor_encode_text_stringz(&request, "id");
+  cbor_encode_int(&request, id);
+  cbor_encode_text_stringz(&request, "method");
+  cbor_encode_text_stringz(&request, method);
+  cbor_encode_text_stringz(&request, "path");
+  cbor_encoder_create_array(&request, &path, CborIndefiniteLength);
+  va_start(args, method);
+  for (const char *s = va_arg(args, const char *); s;
+       s = va_arg(args, const char *)) {
+    cbor_encode_text_stringz(&path, s);
+  }
+  va_end(args);
+  cbor_encoder_close_container(&request, &path);
+  cbor_encoder_close_container(&enc, &request);
+  rx_buffer_size = cbor_encoder_get_buffer_size(&enc, rx_buffer);
+}
+
+START_TEST(test_console_request_while_busy) {
+  /* Events keep the queue from ever emptying */
+  event_log.enabled = 1;
+  console_record_event((struct logged_event){ .type = EVENT_TRIGGER });
+  console_process();
+  ck_assert(!console_tx_empty());
+
+  /* A request is still handled straight away */
+  uint32_t queued = console_tx.tail;
+  receive_request(1, "ping", NULL);
+  console_record_event((struct logged_event){ .type = EVENT_TRIGGER });
+  console_process();
+  ck_assert_int_eq(rx_buffer_size, 0);
+  ck_assert(!console_response.active);
+  ck_assert_int_gt(console_tx.tail, queued);
+
+  /* But waits for room for a short response, holding back any events */
+  static uint8_t message[CONSOLE_TX_SIZE];
+  console_tx_queue(message, console_tx_free() - CONSOLE_RESPONSE_MIN_FREE + 1);
+  queued = console_tx.tail;
+  receive_request(2, "ping", NULL);
+  console_record_event((struct logged_event){ .type = EVENT_TRIGGER });
+  console_process();
+  ck_assert(console_response.active);
+  ck_assert_int_eq(console_tx.tail, queued);
+  ck_assert_int_eq(event_log.read + 1, event_log.write);
+
+  console_tx.head += 1;
+  console_process();
+  ck_assert(!console_response.active);
+  ck_assert_int_eq(rx_buffer_size, 0);
+  ck_assert_int_gt(console_tx.tail, queued);
+}
+END_TEST
+
+/* Renders the whole response to the request in rx_buffer at once */
+static size_t render_response(uint8_t *buf, size_t len) {
+  CborParser parser;
+  CborValue request;
+  CborEncoder enc, response;
+  ck_assert(cbor_parser_init(rx_buffer, rx_buffer_size, 0, &parser,
+                             &request) == CborNoError);
+  cbor_encoder_init(&enc, buf, len, 0);
+  cbor_encoder_create_map(&enc, &response, CborIndefiniteLength);
+  console_process_request(&request, &response);
+  cbor_encoder_close_container(&enc, &response);
+  ck_assert_int_eq(cbor_encoder_get_extra_bytes_needed(&enc), 0);
+  return cbor_encoder_get_buffer_size(&enc, buf);
+}
+
+/* Runs the main loop until the response to the request in rx_buffer is
+ * queued, sending what is queued after each pass as the transport would.
+ * Other messages may follow the response in the last pass */
+static size_t send_response(uint8_t *sent, size_t len) {
+  size_t n_sent = 0;
+  int passes = 0;
+  do {
+    /* Nothing else is queued in the middle of a response */
+    event_log.enabled = 1;
+    console_record_event((struct logged_event){ .type = EVENT_TRIGGER });
+    console_process();
+    passes++;
+    while (!console_tx_empty()) {
+      ck_assert_int_lt(n_sent, len);
+      sent[n_sent++] = console_tx.buf[console_tx.head++ % CONSOLE_TX_SIZE];
+    }
+  } while (console_response.active);
+  ck_assert_int_gt(passes, 1);
+  return n_sent;
+}
+
+START_TEST(test_console_response_across_passes) {
+  static uint8_t expected[16384];
+  static uint8_t sent[16384];
+
+  /* The structure is many times larger than the transmit queue, so is sent a
+   * queue at a time over several passes */
+  receive_request(5, "structure", NULL);
+  size_t len = render_response(expected, sizeof(expected));
+  ck_assert_int_gt(len, 4 * CONSOLE_TX_SIZE);
+  ck_assert_int_ge(send_response(sent, sizeof(sent)), len);
+  ck_assert_int_eq(memcmp(sent, expected, len), 0);
+  ck_assert_int_eq(rx_buffer_size, 0);
+
+  /* As is a whole table */
+  receive_request(6, "get", "tables", "ve", NULL);
+  len = render_response(expected, sizeof(expected));
+  ck_assert_int_gt(len, CONSOLE_TX_SIZE);
+  ck_assert_int_ge(send_response(sent, sizeof(sent)), len);
+  ck_assert_int_eq(memcmp(sent, expected, len), 0);
+
+  CborParser parser;
+  CborValue response, id;
+  int id_value;
+  ck_assert(cbor_parser_init(sent, len, 0, &parser, &response) ==
+            CborNoError);
+  ck_assert(cbor_value_validate_basic(&response) == CborNoError);
+  ck_assert(cbor_value_map_find_value(&response, "id", &id) == CborNoError);
+  ck_assert(cbor_value_get_int(&id, &id_value) == CborNoError);
+  ck_assert_int_eq(id_value, 6);
+}
+END_TEST
+
+START_TEST(test_console_messages_fit_queue) {
+  /* Messages other than responses are queued whole */
+  ck_assert_int_le(EVENT_MESSAGE_MAX_SIZE, CONSOLE_TX_SIZE);
+  ck_assert_int_le(CAPTURE_MESSAGE_MAX_SIZE, CONSOLE_TX_SIZE);
+  ck_assert_int_le(console_feed_line()->len, CONSOLE_TX_SIZE);
+
+  struct console_stream stream;
+  CborEncoder encoder;
+  console_stream_init(&encoder, &stream);
+  console_feed_line_keys(&encoder);
+  ck_assert(!stream.failed);
+}
+END_TEST
+
+START_TEST(test_console_stream_message) {
+  static uint8_t data[CONSOLE_TX_SIZE];
+  struct console_stream stream;
+  CborEncoder encoder;
+
+  ck_assert(console_tx_queue(data, 100));
+
+  /* Messages are encoded straight into the queue */
+  console_stream_init(&encoder, &stream);
+  ck_assert(cbor_encode_byte_string(&encoder, data, 200) == CborNoError);
+  ck_assert_int_eq(console_tx.tail, 100 + 2 + 200);
+
+  /* One that doesn't fit is removed entirely */
+  console_stream_init(&encoder, &stream);
+  ck_assert(cbor_encode_byte_string(&encoder, data, CONSOLE_TX_SIZE - 200) !=
+            CborNoError);
+  ck_assert(stream.failed);
+  ck_assert_int_eq(console_tx.tail, 100 + 2 + 200);
+}
+END_TEST
+
+START_TEST(test_console_feed_line) {
+  config.decoder.rpm = 70000;
+  config.sensors[SENSOR_MAP].processed_value = 101.5;
+
+  /* Values are patched into the template each time */
+  console_feed_line();
+  config.decoder.rpm = 3000;
+  const struct console_feed_template *feed = console_feed_line();
+  memcpy(test_ctx.buf, feed->buf, feed->len);
+  finish_writing();
+
+  CborValue values, value;
+  size_t n_values;
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "values", &values) == CborNoError);
+  ck_assert(cbor_value_get_array_length(&values, &n_values) == CborNoError);
+  cbor_value_enter_container(&values, &value);
+
+  size_t n_nodes = 0;
+  for (const struct console_feed_node *node = &console_feed_nodes[0];
+       node->id != NULL;
+       node++) {
+    if (!strcmp(node->id, "rpm")) {
+      uint64_t rpm;
+      ck_assert(cbor_value_get_uint64(&value, &rpm) == CborNoError);
+      ck_assert_int_eq(rpm, 3000);
+    } else if (!strcmp(node->id, "sensor.map")) {
+      float map;
+      ck_assert(cbor_value_get_float(&value, &map) == CborNoError);
+      ck_assert_float_eq(map, 101.5);
+    }
+    cbor_value_advance(&value);
+    n_nodes++;
+  }
+  ck_assert_int_eq(n_values, n_nodes);
+  ck_assert(cbor_value_at_end(&value));
+}
+END_TEST
+
+static void subscribe_request(uint8_t *buf,
+                              size_t len,
+                              CborValue *request,
+                              CborParser *parser,
+                              const char *key) {
+  CborEncoder enc, request_enc, keys_enc;
+  cbor_encoder_init(&enc, buf, len, 0);
+  cbor_encoder_create_map(&enc, &request_enc, 2);
+  cbor_encode_text_stringz(&request_enc, "keys");
+  cbor_encoder_create_array(&request_enc, &keys_enc, 2);
+  cbor_encode_text_stringz(&keys_enc, "rpm");
+  cbor_encode_text_stringz(&keys_enc, key);
+  cbor_encoder_close_container(&request_enc, &keys_enc);
+  cbor_encode_text_stringz(&request_enc, "interval");
+  cbor_encode_uint(&request_enc, 1000);
+  cbor_encoder_close_container(&enc, &request_enc);
+  cbor_parser_init(buf, len, 0, parser, request);
+}
+
+START_TEST(test_console_request_subscribe) {
+  uint8_t requestbuf[64];
+  CborEncoder response_enc;
+  CborParser parser;
+  CborValue request, field;
+  bool success;
+
+  /* Unknown keys are rejected */
+  subscribe_request(
+    requestbuf, sizeof(requestbuf), &request, &parser, "sensor.xyz");
+  cbor_encoder_create_map(&test_ctx.top_encoder, &response_enc, 2);
+  console_request_subscribe(&response_enc, &request);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &response_enc);
+  finish_writing();
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "success", &field) == CborNoError);
+  ck_assert(cbor_value_get_boolean(&field, &success) == CborNoError);
+  ck_assert(!success);
+  ck_assert(!subscriptions[0].active);
+
+  subscribe_request(
+    requestbuf, sizeof(requestbuf), &request, &parser, "sensor.map");
+  init_console_tests();
+  cbor_encoder_create_map(&test_ctx.top_encoder, &response_enc, 2);
+  console_request_subscribe(&response_enc, &request);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &response_enc);
+  finish_writing();
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "success", &field) == CborNoError);
+  ck_assert(cbor_value_get_boolean(&field, &success) == CborNoError);
+  ck_assert(success);
+
+  int id;
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "subscription", &field) == CborNoError);
+  ck_assert(cbor_value_get_int(&field, &id) == CborNoError);
+  ck_assert_int_eq(id, 0);
+  ck_assert_int_eq(subscriptions[0].interval_us, 1000);
+
+  /* Only the subscribed values are sent, in the order requested */
+  config.decoder.rpm = 1234;
+  config.sensors[SENSOR_MAP].processed_value = 99.0;
+  struct console_feed_template *feed = &subscriptions[id].feed;
+  console_feed_template_patch(feed);
+  memcpy(test_ctx.buf, feed->buf, feed->len);
+  finish_writing();
+
+  CborValue values, value;
+  uint64_t rpm;
+  float map;
+  size_t n_values;
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "values", &values) == CborNoError);
+  ck_assert(cbor_value_get_array_length(&values, &n_values) == CborNoError);
+  ck_assert_int_eq(n_values, 2);
+  cbor_value_enter_container(&values, &value);
+  ck_assert(cbor_value_get_uint64(&value, &rpm) == CborNoError);
+  ck_assert_int_eq(rpm, 1234);
+  cbor_value_advance(&value);
+  ck_assert(cbor_value_get_float(&value, &map) == CborNoError);
+  ck_assert_float_eq(map, 99.0);
+
+  CborEncoder enc, request_enc;
+  cbor_encoder_init(&enc, requestbuf, sizeof(requestbuf), 0);
+  cbor_encoder_create_map(&enc, &request_enc, 1);
+  cbor_encode_text_stringz(&request_enc, "subscription");
+  cbor_encode_int(&request_enc, id);
+  cbor_encoder_close_container(&enc, &request_enc);
+  cbor_parser_init(requestbuf, sizeof(requestbuf), 0, &parser, &request);
+  init_console_tests();
+  cbor_encoder_create_map(&test_ctx.top_encoder, &response_enc, 1);
+  console_request_unsubscribe(&response_enc, &request);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &response_enc);
+  ck_assert(!subscriptions[0].active);
+}
+END_TEST
+
+START_TEST(test_console_subscription_timeout) {
+  uint8_t requestbuf[64];
+  CborEncoder response_enc;
+  CborParser parser;
+  CborValue request;
+
+  set_current_time(time_from_us(1000));
+  subscribe_request(
+    requestbuf, sizeof(requestbuf), &request, &parser, "sensor.map");
+  cbor_encoder_create_map(&test_ctx.top_encoder, &response_enc, 2);
+  console_request_subscribe(&response_enc, &request);
+  cbor_encoder_close_container(&test_ctx.top_encoder, &response_enc);
+  ck_assert(subscriptions[0].active);
+
+  /* Nothing is taken from the queue, but not yet for too long */
+  set_current_time(time_from_us(3000));
+  console_process();
+  ck_assert(!console_tx_empty());
+  set_current_time(time_from_us(3000 + CONSOLE_SUBSCRIPTION_TIMEOUT_US));
+  console_process();
+  ck_assert(subscriptions[0].active);
+
+  /* Sending keeps the subscription going, without any requests */
+  console_tx.head = console_tx.tail;
+  set_current_time(time_from_us(3000 + 2 * CONSOLE_SUBSCRIPTION_TIMEOUT_US));
+  console_process();
+  ck_assert(subscriptions[0].active);
+
+  /* Until the link has stalled for too long */
+  set_current_time(
+    time_from_us(5000 + 3 * CONSOLE_SUBSCRIPTION_TIMEOUT_US));
+  console_process();
+  ck_assert(!subscriptions[0].active);
+
+  /* Which is reported once there is room, and only then frees the id */
+  console_tx.head = console_tx.tail;
+  uint32_t queued = console_tx.tail;
+  console_process();
+  ck_assert(!subscriptions[0].expired);
+  for (uint32_t i = queued; i != console_tx.tail; i++) {
+    test_ctx.buf[i - queued] = console_tx.buf[i % CONSOLE_TX_SIZE];
+  }
+  finish_writing();
+
+  CborValue field;
+  bool match;
+  int id;
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "type", &field) == CborNoError);
+  ck_assert(cbor_value_text_string_equals(&field, "unsubscribed", &match) ==
+            CborNoError);
+  ck_assert(match);
+  ck_assert(cbor_value_map_find_value(
+              &test_ctx.top_value, "subscription", &field) == CborNoError);
+  ck_assert(cbor_value_get_int(&field, &id) == CborNoError);
+  ck_assert_int_eq(id, 0);
+}
+END_TEST
+
 TCase *setup_console_tests() {
   TCase *console_tests = tcase_create("console");
   tcase_add_checked_fixture(
@@ -1645,6 +3283,18 @@ TCase *setup_console_tests() {
   /* Real access / integration tests */
   tcase_add_test(console_tests, test_smoke_console_request_structure);
   tcase_add_test(console_tests, test_smoke_console_request_get_full);
+  tcase_add_test(console_tests, test_console_request_set_table);
+  tcase_add_test(console_tests, test_console_path_index);
+  tcase_add_test(console_tests, test_console_request_capture);
+  tcase_add_test(console_tests, test_console_event_log);
+  tcase_add_test(console_tests, test_console_process_does_not_block);
+  tcase_add_test(console_tests, test_console_request_while_busy);
+  tcase_add_test(console_tests, test_console_response_across_passes);
+  tcase_add_test(console_tests, test_console_messages_fit_queue);
+  tcase_add_test(console_tests, test_console_stream_message);
+  tcase_add_test(console_tests, test_console_feed_line);
+  tcase_add_test(console_tests, test_console_request_subscribe);
+  tcase_add_test(console_tests, test_console_subscription_timeout);
   return console_tests;
 }
 
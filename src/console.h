@@ -31,6 +31,13 @@ struct console_request_context {
 
   bool is_filtered;
   bool is_completed;
+
+  /* Only used while building the path index: the index node of the enclosing
+   * container, and the path segment that reached this one */
+  bool is_indexing;
+  int node;
+  const char *segment_id;
+  int segment_index;
 };
 
 struct console_enum_mapping {
@@ -53,6 +53,36 @@ static unsigned int current_rpm_window_size(unsigned int current_triggers,
   }
 }
 
+static void update_conversion(struct decoder *d) {
+  d->conversion.rpm = d->rpm;
+  if (d->rpm) {
+    d->conversion.ticks_per_degree = tick_degree_rpm_ratio / (float)d->rpm;
+    d->conversion.degrees_per_tick = d->rpm / tick_degree_rpm_ratio;
+  } else {
+    d->conversion.ticks_per_degree = 0;
+    d->conversion.degrees_per_tick = 0;
+  }
+}
+
+timeval_t decoder_time_from_degrees(const struct decoder *d, degrees_t deg) {
+#ifndef FIXED_POINT_CALCULATIONS
+  if (d->conversion.rpm == d->rpm) {
+    return d->conversion.ticks_per_degree * deg;
+  }
+#endif
+  /* rpm was set other than by the decoder, or conversions are integer */
+  return time_from_rpm_diff(d->rpm, deg);
+}
+
+degrees_t decoder_degrees_from_time(const struct decoder *d, timeval_t t) {
+#ifndef FIXED_POINT_CALCULATIONS
+  if (d->conversion.rpm == d->rpm) {
+    return t * d->conversion.degrees_per_tick;
+  }
+#endif
+  return degrees_from_time_diff(t, d->rpm);
+}
+
 /* Update rpm information and validate */
 static void trigger_update_rpm(struct decoder *d) {
   timeval_t diff = d->times[0] - d->times[1];
@@ -72,6 +102,7 @@ static void trigger_update_rpm(struct decoder *d) {
   } else {
     d->rpm = 0;
   }
+  update_conversion(d);
 
   /* Check for excessive per-tooth variation */
   if ((slicerpm <= d->trigger_min_rpm) ||
@@ -218,6 +249,7 @@ void decoder_init(struct decoder *d) {
   d->current_triggers_rpm = 0;
   d->valid = 0;
   d->rpm = 0;
+  update_conversion(d);
   d->state = DECODER_NOSYNC;
   d->last_trigger_time = 0;
   d->last_trigger_angle = 0;
@@ -252,8 +284,10 @@ void decoder_update_scheduling(struct decoder_event *events,
   }
 
   if (config.decoder.valid) {
-    calculate_ignition();
-    calculate_fueling();
+    /* Otherwise schedule with the latest values from the main loop */
+    if (!config.calculations.main_loop) {
+      calculations_update();
+    }
     stats_start_timing(STATS_SCHED_TOTAL_TIME);
     for (unsigned int e = 0; e < MAX_EVENTS; ++e) {
       schedule_event(&config.events[e]);
@@ -267,13 +301,13 @@ degrees_t current_angle() {
   if (!config.decoder.rpm) {
     return config.decoder.last_trigger_angle;
   }
+  /* Convert while the rpm and conversion can't change underneath us */
   disable_interrupts();
   timeval_t last_time = config.decoder.last_trigger_time;
   degrees_t last_angle = config.decoder.last_trigger_angle;
-  enable_interrupts();
-
   degrees_t angle_since_last_tooth =
-    degrees_from_time_diff(current_time() - last_time, config.decoder.rpm);
+    decoder_degrees_from_time(&config.decoder, current_time() - last_time);
+  enable_interrupts();
 
   return clamp_angle(last_angle + angle_since_last_tooth, 720);
 }
@@ -705,6 +739,32 @@ START_TEST(check_update_rpm_window_smaller) {
 }
 END_TEST
 
+START_TEST(check_update_rpm_publishes_conversion) {
+  struct decoder d = {
+    .times = { 400, 300, 200, 100 },
+    .degrees_per_trigger = 30,
+    .current_triggers_rpm = 4,
+    .rpm_window_size = 4,
+    .num_triggers = 24,
+    .trigger_max_rpm_change = 0.5,
+  };
+
+  trigger_update_rpm(&d);
+  ck_assert_int_eq(d.conversion.rpm, d.rpm);
+  ck_assert_int_eq(decoder_time_from_degrees(&d, 90),
+                   time_from_rpm_diff(d.rpm, 90));
+  ck_assert_float_eq_tol(decoder_degrees_from_time(&d, 500),
+                         degrees_from_time_diff(500, d.rpm), 0.001);
+
+  /* rpm changed without the decoder falls back to a full conversion */
+  d.rpm = 2000;
+  ck_assert_int_eq(decoder_time_from_degrees(&d, 90),
+                   time_from_rpm_diff(2000, 90));
+  ck_assert_float_eq_tol(decoder_degrees_from_time(&d, 500),
+                         degrees_from_time_diff(500, 2000), 0.001);
+}
+END_TEST
+
 TCase *setup_decoder_tests() {
   TCase *decoder_tests = tcase_create("decoder");
   tcase_add_test(decoder_tests, check_tfi_decoder_startup_normal);
@@ -724,6 +784,7 @@ TCase *setup_decoder_tests() {
   tcase_add_test(decoder_tests, check_update_rpm_sufficient_points);
   tcase_add_test(decoder_tests, check_update_rpm_window_larger);
   tcase_add_test(decoder_tests, check_update_rpm_window_smaller);
+  tcase_add_test(decoder_tests, check_update_rpm_publishes_conversion);
   return decoder_tests;
 }
 #endif
@@ -7,6 +7,14 @@
 struct decoder;
 typedef void (*decoder_func)(struct decoder *);
 
+/* Conversions between time and angle at the current rpm, published by the
+ * decoder along with rpm so that users only need to multiply */
+struct decoder_conversion {
+  uint32_t rpm; /* rpm these were computed for */
+  float ticks_per_degree;
+  float degrees_per_tick;
+};
+
 typedef enum {
   FORD_TFI,
   TOYOTA_24_1_CAS,
@@ -38,6 +46,7 @@ struct decoder {
   decoder_func decode;
   uint32_t valid;
   uint32_t rpm;
+  struct decoder_conversion conversion;
   timeval_t last_trigger_time;
   degrees_t last_trigger_angle;
   timeval_t expiration;
@@ -81,6 +90,11 @@ void decoder_update_scheduling(struct decoder_event *, unsigned int count);
 void decoder_desync(decoder_loss_reason);
 degrees_t current_angle();
 
+/* Equivalent to time_from_rpm_diff() and degrees_from_time_diff() at the
+ * decoder's rpm, using its published conversion */
+timeval_t decoder_time_from_degrees(const struct decoder *, degrees_t);
+degrees_t decoder_degrees_from_time(const struct decoder *, timeval_t);
+
 #ifdef UNITTEST
 #include <check.h>
 TCase *setup_decoder_tests();
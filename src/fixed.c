@@ -0,0 +1,119 @@
+#include "fixed.h"
+
+int64_t fixed_round_div(int64_t n, int64_t d) {
+  /* C99 division truncates toward zero, so bias away from zero first */
+  if ((n < 0) != (d < 0)) {
+    return (n - d / 2) / d;
+  }
+  return (n + d / 2) / d;
+}
+
+int64_t fixed_descale(int64_t n) {
+  /* Same rounding as fixed_round_div(), with shifts rather than a 64 bit
+   * division */
+  if (n < 0) {
+    return -((-n + FIXED_ONE / 2) >> FIXED_FRAC_BITS);
+  }
+  return (n + FIXED_ONE / 2) >> FIXED_FRAC_BITS;
+}
+
+fixed_t fixed_saturate(int64_t v) {
+  if (v > FIXED_MAX) {
+    return FIXED_MAX;
+  }
+  if (v < FIXED_MIN) {
+    return FIXED_MIN;
+  }
+  return v;
+}
+
+fixed_t fixed_from_float(float f) {
+  float scaled = f * FIXED_ONE;
+  if (scaled != scaled) {
+    /* NaN */
+    return 0;
+  }
+  if (scaled >= 2147483648.0f) {
+    return FIXED_MAX;
+  }
+  if (scaled <= -2147483648.0f) {
+    return FIXED_MIN;
+  }
+  /* Halves away from zero, as lroundf() but without a library call */
+  return (fixed_t)(scaled + ((scaled < 0) ? -0.5f : 0.5f));
+}
+
+fixed_t fixed_from_int(int32_t i) {
+  return fixed_saturate((int64_t)i * FIXED_ONE);
+}
+
+float fixed_to_float(fixed_t f) {
+  return (float)f / FIXED_ONE;
+}
+
+int32_t fixed_to_int(fixed_t f) {
+  return fixed_descale(f);
+}
+
+fixed_t fixed_mul(fixed_t a, fixed_t b) {
+  return fixed_saturate(fixed_descale((int64_t)a * b));
+}
+
+fixed_t fixed_div(fixed_t a, fixed_t b) {
+  if (b == 0) {
+    return (a < 0) ? FIXED_MIN : FIXED_MAX;
+  }
+  return fixed_saturate(fixed_round_div((int64_t)a * FIXED_ONE, b));
+}
+
+#ifdef UNITTEST
+#include <check.h>
+#include <math.h>
+
+START_TEST(check_fixed_conversions) {
+  ck_assert_int_eq(fixed_from_float(1.0f), FIXED_ONE);
+  ck_assert_int_eq(fixed_from_float(-2.5f), -5 * FIXED_ONE / 2);
+  ck_assert_int_eq(fixed_from_int(-3), -3 * FIXED_ONE);
+  ck_assert_float_eq(fixed_to_float(FIXED_ONE / 4), 0.25f);
+
+  /* Halves round away from zero */
+  ck_assert_int_eq(fixed_to_int(FIXED_ONE / 2), 1);
+  ck_assert_int_eq(fixed_to_int(-FIXED_ONE / 2), -1);
+  ck_assert_int_eq(fixed_to_int(FIXED_ONE / 2 - 1), 0);
+
+  /* Out of range values saturate */
+  ck_assert_int_eq(fixed_from_float(40000.0f), FIXED_MAX);
+  ck_assert_int_eq(fixed_from_float(-40000.0f), FIXED_MIN);
+  ck_assert_int_eq(fixed_from_int(40000), FIXED_MAX);
+  ck_assert_int_eq(fixed_from_float(NAN), 0);
+}
+END_TEST
+
+START_TEST(check_fixed_arithmetic) {
+  fixed_t half = FIXED_ONE / 2;
+  ck_assert_int_eq(fixed_mul(fixed_from_int(3), half), 3 * half);
+  ck_assert_int_eq(fixed_mul(fixed_from_int(-3), half), -3 * half);
+  ck_assert_int_eq(fixed_div(fixed_from_int(3), fixed_from_int(2)), 3 * half);
+  ck_assert_int_eq(fixed_div(fixed_from_int(-3), fixed_from_int(2)), -3 * half);
+
+  /* The smallest step times a half rounds away from zero */
+  ck_assert_int_eq(fixed_mul(1, half), 1);
+  ck_assert_int_eq(fixed_mul(-1, half), -1);
+
+  /* One third rounds to nearest */
+  ck_assert_int_eq(fixed_div(FIXED_ONE, fixed_from_int(3)), 21845);
+  ck_assert_int_eq(fixed_div(2 * FIXED_ONE, fixed_from_int(3)), 43691);
+
+  ck_assert_int_eq(fixed_mul(FIXED_MAX, fixed_from_int(2)), FIXED_MAX);
+  ck_assert_int_eq(fixed_div(FIXED_ONE, 0), FIXED_MAX);
+  ck_assert_int_eq(fixed_div(-FIXED_ONE, 0), FIXED_MIN);
+}
+END_TEST
+
+TCase *setup_fixed_tests() {
+  TCase *tc = tcase_create("fixed");
+  tcase_add_test(tc, check_fixed_conversions);
+  tcase_add_test(tc, check_fixed_arithmetic);
+  return tc;
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+/* Signed Q16.16 fixed point. Operations round to nearest with halves rounded
+ * away from zero, and saturate rather than overflow, so that results are the
+ * same on every target regardless of FPU or compiler */
+typedef int32_t fixed_t;
+
+#define FIXED_FRAC_BITS 16
+#define FIXED_ONE ((fixed_t)1 << FIXED_FRAC_BITS)
+#define FIXED_MAX INT32_MAX
+#define FIXED_MIN INT32_MIN
+
+fixed_t fixed_from_float(float);
+fixed_t fixed_from_int(int32_t);
+float fixed_to_float(fixed_t);
+int32_t fixed_to_int(fixed_t);
+
+fixed_t fixed_mul(fixed_t, fixed_t);
+fixed_t fixed_div(fixed_t, fixed_t);
+
+/* Helpers for intermediate results wider than a fixed_t. fixed_descale()
+ * divides by FIXED_ONE, such as to bring a product back to Q16.16 */
+int64_t fixed_round_div(int64_t n, int64_t d);
+int64_t fixed_descale(int64_t);
+fixed_t fixed_saturate(int64_t);
+
+#ifdef UNITTEST
+#include <check.h>
+TCase *setup_fixed_tests();
+#endif
+
+#endif
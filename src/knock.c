@@ -0,0 +1,451 @@
+#include <math.h>
+#include <string.h>
+
+#include "config.h"
+#include "decoder.h"
+#include "knock.h"
+#include "platform.h"
+#include "util.h"
+
+void goertzel_init(struct goertzel *g, float frequency, float sample_rate) {
+  g->coeff = 2.0f * cosf(2 * 3.14159265f * frequency / sample_rate);
+  goertzel_reset(g);
+}
+
+void goertzel_reset(struct goertzel *g) {
+  g->s1 = 0.0f;
+  g->s2 = 0.0f;
+  g->samples = 0;
+}
+
+void goertzel_add(struct goertzel *g, float sample) {
+  float s = sample + g->coeff * g->s1 - g->s2;
+  g->s2 = g->s1;
+  g->s1 = s;
+  g->samples++;
+}
+
+float goertzel_power(const struct goertzel *g) {
+  if (!g->samples) {
+    return 0.0f;
+  }
+  /* Squared magnitude of the DFT term is (A * N / 2)^2 for a sine of
+   * amplitude A, whose mean square is A^2 / 2 */
+  float magnitude = g->s1 * g->s1 + g->s2 * g->s2 - g->coeff * g->s1 * g->s2;
+  float n = g->samples;
+  return 2.0f * magnitude / (n * n);
+}
+
+/* A window is sampled after each ignition event, and its result applies to
+ * that event's cylinder */
+struct knock_window {
+  degrees_t start;
+  uint32_t cylinder;
+};
+
+static struct {
+  struct goertzel filter;
+  struct knock_window windows[MAX_EVENTS];
+  uint32_t num_windows;
+  uint32_t width;
+
+  int active; /* Window being sampled, or -1 */
+  float last_sample;
+
+  /* Between windows, no window can start before next_start, so samples
+   * until then are skipped without finding their angle */
+  bool waiting;
+  timeval_t next_start;
+
+  float background[MAX_CYLINDERS];
+  float retard[MAX_CYLINDERS];
+  fixed_t retard_fixed[MAX_CYLINDERS]; /* Copy for the fixed point path */
+  uint32_t count;
+} knock = { .active = -1 };
+
+void knock_reconfigure() {
+  static struct knock_window windows[MAX_EVENTS];
+  uint32_t num_windows = 0;
+
+  /* The knock band must be below the Nyquist frequency of the samples, or
+   * nothing is measured */
+  bool usable = (config.knock.sample_rate > 0) &&
+                (config.knock.frequency < config.knock.sample_rate / 2);
+
+  memset(windows, 0, sizeof(windows));
+  for (int i = 0; usable && (i < MAX_EVENTS); i++) {
+    const struct output_event *ev = &config.events[i];
+    if ((ev->type != IGNITION_EVENT) || (ev->cylinder >= MAX_CYLINDERS)) {
+      continue;
+    }
+    windows[num_windows] = (struct knock_window){
+      .start = clamp_angle(ev->angle + config.knock.window_offset, 720),
+      .cylinder = ev->cylinder,
+    };
+    num_windows++;
+  }
+
+  /* Retard only recovers while knock detection runs, so none is kept once it
+   * is disabled */
+  if (!config.knock.enabled) {
+    disable_interrupts();
+    for (int i = 0; i < MAX_CYLINDERS; i++) {
+      knock.retard[i] = 0.0f;
+      knock.retard_fixed[i] = 0;
+    }
+    enable_interrupts();
+  }
+
+  struct goertzel filter = { 0 };
+  if (usable) {
+    goertzel_init(&filter, config.knock.frequency, config.knock.sample_rate);
+  }
+
+  /* Background energy is only meaningful for the same windows and filter */
+  if ((num_windows == knock.num_windows) &&
+      (config.knock.window_width == knock.width) &&
+      (filter.coeff == knock.filter.coeff) &&
+      !memcmp(windows, knock.windows, sizeof(windows))) {
+    return;
+  }
+
+  disable_interrupts();
+  memcpy(knock.windows, windows, sizeof(windows));
+  knock.num_windows = num_windows;
+  knock.width = config.knock.window_width;
+  knock.filter = filter;
+  knock.active = -1;
+  knock.waiting = false;
+  for (int i = 0; i < MAX_CYLINDERS; i++) {
+    knock.background[i] = 0.0f;
+  }
+  enable_interrupts();
+}
+
+static bool in_window(const struct knock_window *w, degrees_t angle) {
+  return clamp_angle(angle - w->start, 720) < knock.width;
+}
+
+static void knock_window_finish(uint32_t cylinder) {
+  float energy = goertzel_power(&knock.filter);
+  float *background = &knock.background[cylinder];
+  float *retard = &knock.retard[cylinder];
+
+  /* The first window of a cylinder only establishes its background */
+  if (*background == 0.0f) {
+    *background = energy;
+    return;
+  }
+
+  if (energy > config.knock.threshold * *background) {
+    knock.count++;
+    *retard += config.knock.retard_step;
+    if (*retard > config.knock.retard_max) {
+      *retard = config.knock.retard_max;
+    }
+  } else {
+    *background += config.knock.background_weight * (energy - *background);
+    *retard -= config.knock.recovery;
+    if (*retard < 0.0f) {
+      *retard = 0.0f;
+    }
+  }
+  knock.retard_fixed[cylinder] = fixed_from_float(*retard);
+}
+
+/* Skip samples until shortly before the next window is reached at the
+ * current rpm. The angle is checked again then, in case the engine
+ * accelerated, so each gap between windows costs a few angle lookups */
+static void knock_wait_for_window(degrees_t distance, timeval_t now) {
+  if (!config.decoder.rpm) {
+    return;
+  }
+  disable_interrupts();
+  timeval_t wait =
+    decoder_time_from_degrees(&config.decoder, distance - distance / 8);
+  enable_interrupts();
+  knock.next_start = now + wait;
+  knock.waiting = true;
+}
+
+void knock_add_sample(uint32_t raw) {
+  if (!config.knock.enabled || !config.decoder.valid) {
+    knock.active = -1;
+    knock.waiting = false;
+    return;
+  }
+
+  /* Filtering the first difference rather than the raw samples removes the
+   * sensor's DC offset. The gain at the knock frequency is constant, so
+   * doesn't change the ratio to the background */
+  float sample = (float)raw - knock.last_sample;
+  knock.last_sample = raw;
+
+  timeval_t now = current_time();
+  if (knock.waiting && time_before(now, knock.next_start)) {
+    return;
+  }
+  knock.waiting = false;
+
+  degrees_t angle = current_angle();
+  if (knock.active >= 0) {
+    if (in_window(&knock.windows[knock.active], angle)) {
+      goertzel_add(&knock.filter, sample);
+      return;
+    }
+    knock_window_finish(knock.windows[knock.active].cylinder);
+    knock.active = -1;
+  }
+
+  degrees_t distance = 720;
+  for (uint32_t i = 0; i < knock.num_windows; i++) {
+    if (in_window(&knock.windows[i], angle)) {
+      knock.active = i;
+      goertzel_reset(&knock.filter);
+      goertzel_add(&knock.filter, sample);
+      return;
+    }
+    degrees_t to_start = clamp_angle(knock.windows[i].start - angle, 720);
+    if (to_start < distance) {
+      distance = to_start;
+    }
+  }
+  knock_wait_for_window(distance, now);
+}
+
+float knock_retard(int cylinder) {
+  if (!config.knock.enabled) {
+    return 0.0f;
+  }
+  return knock.retard[cylinder];
+}
+
+fixed_t knock_retard_fixed(int cylinder) {
+  if (!config.knock.enabled) {
+    return 0;
+  }
+  return knock.retard_fixed[cylinder];
+}
+
+float knock_max_retard() {
+  float max = 0.0f;
+  if (!config.knock.enabled) {
+    return max;
+  }
+  for (int i = 0; i < MAX_CYLINDERS; i++) {
+    if (knock.retard[i] > max) {
+      max = knock.retard[i];
+    }
+  }
+  return max;
+}
+
+uint32_t knock_count() {
+  return knock.count;
+}
+
+#ifdef UNITTEST
+#include <check.h>
+
+#define TEST_SAMPLE_RATE 50000.0f
+#define TEST_KNOCK_FREQUENCY 6500.0f
+
+START_TEST(check_goertzel_power) {
+  struct goertzel g;
+  goertzel_init(&g, TEST_KNOCK_FREQUENCY, TEST_SAMPLE_RATE);
+
+  /* A sine at the filter frequency is measured as its mean square */
+  for (int i = 0; i < 500; i++) {
+    float t = i / TEST_SAMPLE_RATE;
+    float phase = 2 * 3.14159265f * TEST_KNOCK_FREQUENCY * t;
+    goertzel_add(&g, 100.0f * sinf(phase));
+  }
+  ck_assert_float_eq_tol(goertzel_power(&g), 5000.0f, 250.0f);
+
+  /* One well away from it is mostly rejected */
+  goertzel_reset(&g);
+  for (int i = 0; i < 500; i++) {
+    float t = i / TEST_SAMPLE_RATE;
+    goertzel_add(&g, 100.0f * sinf(2 * 3.14159265f * 2000.0f * t));
+  }
+  ck_assert_float_lt(goertzel_power(&g), 50.0f);
+}
+END_TEST
+
+static void knock_test_setup() {
+  config.decoder.valid = 1;
+  config.decoder.rpm = 0;
+  config.knock = (struct knock_config){
+    .enabled = 1,
+    .sample_rate = TEST_SAMPLE_RATE,
+    .frequency = TEST_KNOCK_FREQUENCY,
+    .window_offset = 10,
+    .window_width = 60,
+    .threshold = 4.0,
+    .background_weight = 0.1,
+    .retard_step = 2.0,
+    .retard_max = 5.0,
+    .recovery = 0.5,
+  };
+  for (int i = 0; i < MAX_EVENTS; i++) {
+    config.events[i].type = DISABLED_EVENT;
+  }
+  config.events[0].type = IGNITION_EVENT;
+  config.events[0].angle = 0;
+  config.events[0].cylinder = 0;
+  config.events[1].type = IGNITION_EVENT;
+  config.events[1].angle = 360;
+  config.events[1].cylinder = 1;
+  knock_reconfigure();
+}
+
+#define TEST_TICKS_PER_SAMPLE (TICKRATE / (int)TEST_SAMPLE_RATE)
+
+/* Feeds a cycle of synthetic samples at 3000 rpm: engine noise, a little
+ * energy in the knock band, and optionally a knock burst in one cylinder's
+ * window */
+static void knock_test_cycle(int knocking_cylinder) {
+  const float degrees_per_sample = 3000 * 6 / TEST_SAMPLE_RATE;
+  const degrees_t knock_start = 20 + 360 * knocking_cylinder;
+  static uint32_t n = 0;
+
+  config.decoder.rpm = 3000;
+  config.decoder.last_trigger_angle = 0;
+  config.decoder.last_trigger_time = n * TEST_TICKS_PER_SAMPLE;
+  for (degrees_t angle = 0; angle < 720; angle += degrees_per_sample) {
+    set_current_time(n * TEST_TICKS_PER_SAMPLE);
+    float t = n++ / TEST_SAMPLE_RATE;
+    float knock_band = sinf(2 * 3.14159265f * TEST_KNOCK_FREQUENCY * t);
+    float signal =
+      200.0f * sinf(2 * 3.14159265f * 900.0f * t) + 5.0f * knock_band;
+    if ((knocking_cylinder >= 0) && (angle >= knock_start) &&
+        (angle < knock_start + 30)) {
+      signal += 80.0f * knock_band;
+    }
+    knock_add_sample(2048 + signal);
+  }
+}
+
+START_TEST(check_knock_retards_knocking_cylinder) {
+  knock_test_setup();
+
+  for (int i = 0; i < 10; i++) {
+    knock_test_cycle(-1);
+  }
+  ck_assert_float_eq(knock_retard(0), 0.0f);
+  ck_assert_float_eq(knock_retard(1), 0.0f);
+  ck_assert_int_eq(knock_count(), 0);
+
+  /* Knock in cylinder 1 only retards cylinder 1, up to the limit */
+  knock_test_cycle(1);
+  ck_assert_float_eq(knock_retard(0), 0.0f);
+  ck_assert_float_eq(knock_retard(1), 2.0f);
+  knock_test_cycle(1);
+  knock_test_cycle(1);
+  ck_assert_float_eq(knock_retard(1), 5.0f);
+  ck_assert_float_eq(knock_max_retard(), 5.0f);
+  ck_assert_int_eq(knock_count(), 3);
+
+  /* And recovers once quiet */
+  knock_test_cycle(-1);
+  ck_assert_float_eq(knock_retard(1), 4.5f);
+  for (int i = 0; i < 10; i++) {
+    knock_test_cycle(-1);
+  }
+  ck_assert_float_eq(knock_retard(1), 0.0f);
+
+  knock_test_cycle(0);
+  ck_assert_float_eq(knock_retard(0), 2.0f);
+  ck_assert_float_eq(knock_retard(1), 0.0f);
+
+  /* Disabling knock detection removes any retard */
+  config.knock.enabled = 0;
+  ck_assert_float_eq(knock_retard(0), 0.0f);
+  knock_reconfigure();
+  config.knock.enabled = 1;
+  ck_assert_float_eq(knock_retard(0), 0.0f);
+  ck_assert_float_eq(knock_max_retard(), 0.0f);
+}
+END_TEST
+
+START_TEST(check_knock_frequency_above_nyquist) {
+  knock_test_setup();
+  config.knock.frequency = TEST_SAMPLE_RATE / 2;
+  knock_reconfigure();
+
+  for (int i = 0; i < 10; i++) {
+    knock_test_cycle(-1);
+  }
+  knock_test_cycle(1);
+  ck_assert_float_eq(knock_retard(1), 0.0f);
+  ck_assert_int_eq(knock_count(), 0);
+}
+END_TEST
+
+START_TEST(check_knock_retard_applied_to_ignition) {
+  knock_test_setup();
+  for (int i = 0; i < 10; i++) {
+    knock_test_cycle(-1);
+  }
+
+  config.decoder.rpm = 2000;
+  sensor_set_value(&config.sensors[SENSOR_MAP], 100);
+  calculations_invalidate();
+  calculate_ignition();
+  float advance = calculated_values.cylinder_timing_advance[1];
+
+  knock_test_cycle(1);
+  config.decoder.rpm = 2000;
+
+  calculate_ignition();
+  ck_assert_float_eq_tol(
+    calculated_values.cylinder_timing_advance[1], advance - 2.0f, 0.001f);
+
+#ifdef FIXED_POINT_CALCULATIONS
+  calculations_invalidate();
+  calculate_ignition_fixed();
+  ck_assert_float_eq_tol(
+    calculated_values.cylinder_timing_advance[1], advance - 2.0f, 0.01f);
+#endif
+}
+END_TEST
+
+START_TEST(check_knock_waits_between_windows) {
+  knock_test_setup();
+  config.decoder.rpm = 3000;
+  config.decoder.last_trigger_angle = 100;
+  config.decoder.last_trigger_time = 1000;
+  set_current_time(1000);
+
+  /* Past the window at 10 degrees, the next starts at 370, and is waited for
+   * until 7/8 of the way there */
+  knock_add_sample(2048);
+  ck_assert(knock.waiting);
+  ck_assert_int_eq(knock.active, -1);
+  ck_assert_int_eq(knock.next_start,
+                   1000 + time_from_rpm_diff(3000, 270 - 270 / 8.0f));
+
+  /* After which the angle is found again */
+  set_current_time(knock.next_start);
+  knock_add_sample(2048);
+  ck_assert(knock.waiting);
+  ck_assert_int_gt(knock.next_start, 1000 + time_from_rpm_diff(3000, 263));
+
+  /* And the window is sampled once reached */
+  set_current_time(1000 + time_from_rpm_diff(3000, 275));
+  knock_add_sample(2048);
+  ck_assert(!knock.waiting);
+  ck_assert_int_eq(knock.active, 1);
+}
+END_TEST
+
+TCase *setup_knock_tests() {
+  TCase *tc = tcase_create("knock");
+  tcase_add_test(tc, check_goertzel_power);
+  tcase_add_test(tc, check_knock_retards_knocking_cylinder);
+  tcase_add_test(tc, check_knock_frequency_above_nyquist);
+  tcase_add_test(tc, check_knock_retard_applied_to_ignition);
+  tcase_add_test(tc, check_knock_waits_between_windows);
+  return tc;
+}
+#endif
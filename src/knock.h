@@ -0,0 +1,55 @@
+#ifndef _KNOCK_H
+#define _KNOCK_H
+
+#include <stdint.h>
+
+#include "calculations.h"
+
+struct knock_config {
+  uint32_t enabled;
+  uint32_t pin;           /* ADC pin of the knock sensor */
+  float sample_rate;      /* Knock sensor samples per second */
+  float frequency;        /* Center of the knock band (Hz) */
+  uint32_t window_offset; /* Degrees after each ignition event's angle */
+  uint32_t window_width;  /* Degrees */
+
+  float threshold;         /* Window energy over background that is knock */
+  float background_weight; /* Weight of each quiet window in the background */
+  float retard_step;       /* Degrees retarded for each knocking window */
+  float retard_max;        /* Degrees */
+  float recovery;          /* Degrees restored for each quiet window */
+};
+
+/* Goertzel filter for the energy at a single frequency, at a fixed cost of
+ * one multiply and two adds per sample */
+struct goertzel {
+  float coeff;
+  float s1, s2;
+  uint32_t samples;
+};
+
+void goertzel_init(struct goertzel *, float frequency, float sample_rate);
+void goertzel_reset(struct goertzel *);
+void goertzel_add(struct goertzel *, float sample);
+/* Mean square amplitude at the filter frequency of the samples since reset */
+float goertzel_power(const struct goertzel *);
+
+/* Rebuild the knock windows and filter after the knock config or events have
+ * changed */
+void knock_reconfigure();
+
+/* Called with each knock sensor sample */
+void knock_add_sample(uint32_t raw);
+
+/* Degrees of timing currently removed from each cylinder */
+float knock_retard(int cylinder);
+fixed_t knock_retard_fixed(int cylinder);
+float knock_max_retard();
+uint32_t knock_count();
+
+#ifdef UNITTEST
+#include <check.h>
+TCase *setup_knock_tests();
+#endif
+
+#endif
@@ -0,0 +1,536 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_CYCLE_COUNTER
+#endif
+
+#include "calculations.h"
+#include "capture.h"
+#include "config.h"
+#include "console.h"
+#include "decoder.h"
+#include "knock.h"
+#include "offline.h"
+#include "platform.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "table.h"
+#include "util.h"
+
+/* Number of timed runs per benchmark, the fastest of which is reported */
+#define BENCH_RUNS 7
+/* Minimum duration of a single timed run */
+#define BENCH_MIN_RUN_NS 20000000
+/* Inputs are cycled through so that lookups don't always hit the same bin */
+#define BENCH_INPUTS 256
+
+static uint64_t cycles() {
+#ifdef HAS_CYCLE_COUNTER
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+timeval_t cycle_count() {
+  return (timeval_t)cycles();
+}
+
+/* Request waiting to be read by the console */
+static const uint8_t *console_rx;
+static size_t console_rx_len;
+
+size_t console_read(void *ptr, size_t max) {
+  size_t len = (console_rx_len < max) ? console_rx_len : max;
+  memcpy(ptr, console_rx, len);
+  console_rx += len;
+  console_rx_len -= len;
+  return len;
+}
+
+/* Results are written here to keep the compiler from discarding work */
+static volatile float float_sink;
+static volatile uint32_t uint_sink;
+
+static float rpm_inputs[BENCH_INPUTS];
+static float map_inputs[BENCH_INPUTS];
+static fixed_t rpm_inputs_fixed[BENCH_INPUTS];
+static fixed_t map_inputs_fixed[BENCH_INPUTS];
+static float adc_inputs[BENCH_INPUTS];
+static timeval_t time_inputs[BENCH_INPUTS];
+
+static void bench_inputs_init() {
+  /* Fixed seed for repeatable runs */
+  srand(1);
+  for (int i = 0; i < BENCH_INPUTS; i++) {
+    rpm_inputs[i] = 500 + rand() % 7000;
+    map_inputs[i] = 20 + rand() % 230;
+    rpm_inputs_fixed[i] = fixed_from_float(rpm_inputs[i]);
+    map_inputs_fixed[i] = fixed_from_float(map_inputs[i]);
+    adc_inputs[i] = 100 + rand() % 3900;
+    time_inputs[i] = 1000 + rand() % 1000000;
+  }
+}
+
+static void bench_interpolate_oneaxis(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink = interpolate_table_oneaxis(
+      config.injector_pw_compensation, map_inputs[i % BENCH_INPUTS] / 20);
+  }
+}
+
+static void bench_interpolate_oneaxis_unchecked(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink = interpolate_table_oneaxis_unchecked(
+      config.injector_pw_compensation, map_inputs[i % BENCH_INPUTS] / 20);
+  }
+}
+
+static void bench_interpolate_twoaxis(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink = interpolate_table_twoaxis(config.ve,
+                                           rpm_inputs[i % BENCH_INPUTS],
+                                           map_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+static void bench_interpolate_twoaxis_unchecked(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink =
+      interpolate_table_twoaxis_unchecked(config.ve,
+                                          rpm_inputs[i % BENCH_INPUTS],
+                                          map_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+#ifdef FIXED_POINT_CALCULATIONS
+static void bench_interpolate_twoaxis_fixed(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    uint_sink = interpolate_table_twoaxis_fixed(
+      config.ve,
+      rpm_inputs_fixed[i % BENCH_INPUTS],
+      map_inputs_fixed[i % BENCH_INPUTS]);
+  }
+}
+#endif
+
+/* Reported per point evaluated */
+static void bench_interpolate_twoaxis_batch(uint64_t n) {
+  float out[BENCH_INPUTS];
+  for (uint64_t i = 0; i < n; i += BENCH_INPUTS) {
+    interpolate_table_twoaxis_batch(
+      config.ve, rpm_inputs, map_inputs, out, BENCH_INPUTS);
+    float_sink = out[i % BENCH_INPUTS];
+  }
+}
+
+static void bench_calculate_fueling(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    config.decoder.rpm = rpm_inputs[i % BENCH_INPUTS];
+    config.sensors[SENSOR_MAP].processed_value = map_inputs[i % BENCH_INPUTS];
+    calculate_fueling();
+    uint_sink = calculated_values.fueling_us;
+  }
+}
+
+/* Inputs moving within their epsilons, as with a steady engine */
+static void bench_calculate_fueling_steady(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    config.decoder.rpm = 3000 + (i % 2);
+    config.sensors[SENSOR_MAP].processed_value = 100.0f + (i % 2) * 0.1f;
+    calculate_fueling();
+    uint_sink = calculated_values.fueling_us;
+  }
+}
+
+#ifdef FIXED_POINT_CALCULATIONS
+static void bench_calculate_fueling_fixed(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    config.decoder.rpm = rpm_inputs[i % BENCH_INPUTS];
+    sensor_set_value(&config.sensors[SENSOR_MAP], map_inputs[i % BENCH_INPUTS]);
+    calculate_fueling_fixed();
+    uint_sink = calculated_values.fueling_us;
+  }
+}
+#endif
+
+static void bench_calculate_slow_fueling(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    config.sensors[SENSOR_CLT].processed_value = map_inputs[i % BENCH_INPUTS];
+    calculate_slow_fueling();
+  }
+}
+
+static void bench_calculate_ignition(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    config.decoder.rpm = rpm_inputs[i % BENCH_INPUTS];
+    config.sensors[SENSOR_MAP].processed_value = map_inputs[i % BENCH_INPUTS];
+    calculate_ignition();
+    float_sink = calculated_values.timing_advance;
+  }
+}
+
+#ifdef FIXED_POINT_CALCULATIONS
+static void bench_calculate_ignition_fixed(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    config.decoder.rpm = rpm_inputs[i % BENCH_INPUTS];
+    sensor_set_value(&config.sensors[SENSOR_MAP], map_inputs[i % BENCH_INPUTS]);
+    calculate_ignition_fixed();
+    float_sink = calculated_values.timing_advance;
+  }
+}
+#endif
+
+static void bench_sensor_convert_thermistor(uint64_t n) {
+  struct thermistor_config *tc = &config.sensors[SENSOR_CLT].therm;
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink = sensor_convert_thermistor(tc, adc_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+static void bench_thermistor_table_lookup(uint64_t n) {
+  static struct thermistor_table t;
+  thermistor_table_build(&t, &config.sensors[SENSOR_CLT].therm);
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink = thermistor_table_lookup(&t, adc_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+static void bench_sensor_history(uint64_t n, sensor_filter type) {
+  static struct sensor_history h;
+  sensor_history_reset(&h,
+                       &(struct sensor_filter_config){
+                         .type = type,
+                         .width = 8,
+                         .cutoff = 0.1,
+                       });
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink = sensor_history_add(&h, i, adc_inputs[i % BENCH_INPUTS]);
+    float_sink = sensor_history_slope(&h);
+  }
+}
+
+static void bench_sensor_history_average(uint64_t n) {
+  bench_sensor_history(n, FILTER_AVERAGE);
+}
+
+static void bench_sensor_history_median(uint64_t n) {
+  bench_sensor_history(n, FILTER_MEDIAN);
+}
+
+static void bench_sensor_history_lowpass(uint64_t n) {
+  bench_sensor_history(n, FILTER_LOWPASS);
+}
+
+/* Whole ADC interrupt's sensor processing with the default sensors, at
+ * their configured decimation and with every sensor converted each sample */
+static void bench_sensors_process_adc(uint64_t n) {
+  config.decoder.valid = 1;
+  config.decoder.rpm = 3000;
+  sensors_reconfigure();
+  for (uint64_t i = 0; i < n; i++) {
+    config.decoder.last_trigger_angle = map_inputs[i % BENCH_INPUTS] * 2;
+    config.decoder.last_trigger_time = current_time();
+    for (int s = 0; s < NUM_SENSORS; s++) {
+      config.sensors[s].raw_value = adc_inputs[(i + s) % BENCH_INPUTS];
+    }
+    sensors_process(SENSOR_ADC);
+  }
+}
+
+static void bench_sensors_process_adc_undecimated(uint64_t n) {
+  uint32_t decimation[NUM_SENSORS];
+  for (int s = 0; s < NUM_SENSORS; s++) {
+    decimation[s] = config.sensors[s].decimation;
+    config.sensors[s].decimation = 0;
+  }
+  bench_sensors_process_adc(n);
+  for (int s = 0; s < NUM_SENSORS; s++) {
+    config.sensors[s].decimation = decimation[s];
+  }
+}
+
+/* Per-sample cost added to the ADC interrupt while a capture is recording,
+ * restarting the capture whenever the buffer fills */
+static void bench_capture_record(uint64_t n) {
+  config.decoder.valid = 1;
+  config.decoder.rpm = 3000;
+  config.sensors[SENSOR_MAP].source = SENSOR_ADC;
+  config.sensors[SENSOR_TPS].source = SENSOR_ADC;
+  uint32_t sensors = (1 << SENSOR_MAP) | (1 << SENSOR_TPS);
+  for (uint64_t i = 0; i < n; i++) {
+    if (!capture_recording()) {
+      capture_start(sensors, UINT32_MAX);
+    }
+    config.decoder.last_trigger_angle = map_inputs[i % BENCH_INPUTS] * 2;
+    config.decoder.last_trigger_time = current_time();
+    config.sensors[SENSOR_MAP].raw_value = adc_inputs[i % BENCH_INPUTS];
+    capture_record();
+  }
+  capture_cancel();
+}
+
+/* One operation is a whole knock window: 60 degrees at 3000 rpm, sampled at
+ * 50 khz */
+#define BENCH_KNOCK_WINDOW_SAMPLES 167
+
+static void bench_goertzel_window(uint64_t n) {
+  struct goertzel g;
+  goertzel_init(&g, 6500, 50000);
+  for (uint64_t i = 0; i < n; i++) {
+    goertzel_reset(&g);
+    for (int s = 0; s < BENCH_KNOCK_WINDOW_SAMPLES; s++) {
+      goertzel_add(&g, adc_inputs[(i + s) % BENCH_INPUTS]);
+    }
+    float_sink = goertzel_power(&g);
+  }
+}
+
+/* Per-sample cost in the ADC interrupt, moving through the windows of six
+ * ignition events. The angle follows the host clock at 3000 rpm, so samples
+ * between windows take the same path as on an engine */
+static void bench_knock_add_sample(uint64_t n) {
+  const timeval_t cycle = time_from_rpm_diff(3000, 720);
+  config.knock.enabled = 1;
+  config.decoder.valid = 1;
+  config.decoder.rpm = 3000;
+  config.decoder.last_trigger_angle = 0;
+  config.decoder.last_trigger_time = current_time();
+  knock_reconfigure();
+  for (uint64_t i = 0; i < n; i++) {
+    if (current_time() - config.decoder.last_trigger_time >= cycle) {
+      config.decoder.last_trigger_time += cycle;
+    }
+    knock_add_sample(adc_inputs[i % BENCH_INPUTS]);
+  }
+  config.knock.enabled = 0;
+}
+
+/* One main loop pass of the console with no requests, which is almost always
+ * a full feed message */
+static void bench_console_process(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    console_process();
+  }
+}
+
+/* One main loop pass of the console handling a set of a single field deep in
+ * the tree, as tuning software sends while editing */
+static void bench_console_request_set(uint64_t n) {
+  uint8_t request[64];
+  CborEncoder enc, map, path;
+  cbor_encoder_init(&enc, request, sizeof(request), 0);
+  cbor_encoder_create_map(&enc, &map, 4);
+  cbor_encode_text_stringz(&map, "id");
+  cbor_encode_int(&map, 1);
+  cbor_encode_text_stringz(&map, "method");
+  cbor_encode_text_stringz(&map, "set");
+  cbor_encode_text_stringz(&map, "path");
+  cbor_encoder_create_array(&map, &path, 3);
+  cbor_encode_text_stringz(&path, "freq");
+  cbor_encode_int(&path, 1);
+  cbor_encode_text_stringz(&path, "timeout");
+  cbor_encoder_close_container(&map, &path);
+  cbor_encode_text_stringz(&map, "value");
+  cbor_encode_int(&map, 100000);
+  cbor_encoder_close_container(&enc, &map);
+  size_t len = cbor_encoder_get_buffer_size(&enc, request);
+
+  for (uint64_t i = 0; i < n; i++) {
+    console_rx = request;
+    console_rx_len = len;
+    console_process();
+  }
+}
+
+static void bench_rpm_from_time_diff(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    uint_sink = rpm_from_time_diff(time_inputs[i % BENCH_INPUTS], 90);
+  }
+}
+
+static void bench_time_from_rpm_diff(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    uint_sink = time_from_rpm_diff(rpm_inputs[i % BENCH_INPUTS], 90);
+  }
+}
+
+static void bench_degrees_from_time_diff(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink = degrees_from_time_diff(time_inputs[i % BENCH_INPUTS],
+                                        rpm_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+static void bench_time_from_us(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    uint_sink = time_from_us(time_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+static void bench_rpm_from_time_diff_fixed(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    uint_sink =
+      rpm_from_time_diff_fixed(time_inputs[i % BENCH_INPUTS], 90 * FIXED_ONE);
+  }
+}
+
+static void bench_time_from_rpm_diff_fixed(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    uint_sink =
+      time_from_rpm_diff_fixed(rpm_inputs[i % BENCH_INPUTS], 90 * FIXED_ONE);
+  }
+}
+
+static void bench_degrees_from_time_diff_fixed(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    uint_sink = degrees_from_time_diff_fixed(time_inputs[i % BENCH_INPUTS],
+                                             rpm_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+static void bench_time_from_us_fixed(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    uint_sink = time_from_us_fixed(time_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+/* The decoder publishes its conversion once per tooth, so hold rpm while
+ * converting many angles and times as the scheduler does */
+static void bench_decoder_time_from_degrees(uint64_t n) {
+  struct decoder d = { .rpm = 3000 };
+  d.conversion = (struct decoder_conversion){
+    .rpm = 3000,
+    .ticks_per_degree = tick_degree_rpm_ratio / 3000.0f,
+    .degrees_per_tick = 3000.0f / tick_degree_rpm_ratio,
+  };
+  for (uint64_t i = 0; i < n; i++) {
+    uint_sink = decoder_time_from_degrees(&d, map_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+static void bench_decoder_degrees_from_time(uint64_t n) {
+  struct decoder d = { .rpm = 3000 };
+  d.conversion = (struct decoder_conversion){
+    .rpm = 3000,
+    .ticks_per_degree = tick_degree_rpm_ratio / 3000.0f,
+    .degrees_per_tick = 3000.0f / tick_degree_rpm_ratio,
+  };
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink = decoder_degrees_from_time(&d, time_inputs[i % BENCH_INPUTS]);
+  }
+}
+
+static void bench_clamp_angle(uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    float_sink = clamp_angle(map_inputs[i % BENCH_INPUTS] * 7, 720);
+  }
+}
+
+struct benchmark {
+  const char *name;
+  void (*run)(uint64_t iterations);
+};
+
+static const struct benchmark benchmarks[] = {
+  { "interpolate_table_oneaxis", bench_interpolate_oneaxis },
+  { "interpolate_table_oneaxis_unchecked",
+    bench_interpolate_oneaxis_unchecked },
+  { "interpolate_table_twoaxis", bench_interpolate_twoaxis },
+  { "interpolate_table_twoaxis_unchecked",
+    bench_interpolate_twoaxis_unchecked },
+#ifdef FIXED_POINT_CALCULATIONS
+  { "interpolate_table_twoaxis_fixed", bench_interpolate_twoaxis_fixed },
+#endif
+  { "interpolate_table_twoaxis_batch", bench_interpolate_twoaxis_batch },
+  { "calculate_fueling", bench_calculate_fueling },
+  { "calculate_fueling_steady", bench_calculate_fueling_steady },
+#ifdef FIXED_POINT_CALCULATIONS
+  { "calculate_fueling_fixed", bench_calculate_fueling_fixed },
+#endif
+  { "calculate_slow_fueling", bench_calculate_slow_fueling },
+  { "calculate_ignition", bench_calculate_ignition },
+#ifdef FIXED_POINT_CALCULATIONS
+  { "calculate_ignition_fixed", bench_calculate_ignition_fixed },
+#endif
+  { "sensor_convert_thermistor", bench_sensor_convert_thermistor },
+  { "thermistor_table_lookup", bench_thermistor_table_lookup },
+  { "sensor_history_average", bench_sensor_history_average },
+  { "sensor_history_median", bench_sensor_history_median },
+  { "sensor_history_lowpass", bench_sensor_history_lowpass },
+  { "sensors_process_adc", bench_sensors_process_adc },
+  { "sensors_process_adc_undecimated",
+    bench_sensors_process_adc_undecimated },
+  { "capture_record", bench_capture_record },
+  { "goertzel_window", bench_goertzel_window },
+  { "knock_add_sample", bench_knock_add_sample },
+  { "console_process", bench_console_process },
+  { "console_request_set", bench_console_request_set },
+  { "rpm_from_time_diff", bench_rpm_from_time_diff },
+  { "time_from_rpm_diff", bench_time_from_rpm_diff },
+  { "degrees_from_time_diff", bench_degrees_from_time_diff },
+  { "time_from_us", bench_time_from_us },
+  { "rpm_from_time_diff_fixed", bench_rpm_from_time_diff_fixed },
+  { "time_from_rpm_diff_fixed", bench_time_from_rpm_diff_fixed },
+  { "degrees_from_time_diff_fixed", bench_degrees_from_time_diff_fixed },
+  { "time_from_us_fixed", bench_time_from_us_fixed },
+  { "decoder_time_from_degrees", bench_decoder_time_from_degrees },
+  { "decoder_degrees_from_time", bench_decoder_degrees_from_time },
+  { "clamp_angle", bench_clamp_angle },
+};
+
+/* Picks an iteration count that takes at least BENCH_MIN_RUN_NS, then reports
+ * the fastest of several runs as one JSON object per line */
+static void run_benchmark(const struct benchmark *b) {
+  uint64_t iterations = BENCH_INPUTS;
+  while (1) {
+    uint64_t start = monotonic_ns();
+    b->run(iterations);
+    if (monotonic_ns() - start >= BENCH_MIN_RUN_NS) {
+      break;
+    }
+    iterations *= 2;
+  }
+
+  uint64_t best_ns = UINT64_MAX;
+  uint64_t best_cycles = UINT64_MAX;
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    uint64_t start_cycles = cycles();
+    uint64_t start = monotonic_ns();
+    b->run(iterations);
+    uint64_t ns = monotonic_ns() - start;
+    uint64_t cyc = cycles() - start_cycles;
+    if (ns < best_ns) {
+      best_ns = ns;
+    }
+    if (cyc < best_cycles) {
+      best_cycles = cyc;
+    }
+  }
+
+  printf("{\"benchmark\": \"%s\", \"iterations\": %" PRIu64
+         ", \"ns_per_op\": %.3f, \"cycles_per_op\": ",
+         b->name,
+         iterations,
+         (double)best_ns / iterations);
+#ifdef HAS_CYCLE_COUNTER
+  printf("%.3f}\n", (double)best_cycles / iterations);
+#else
+  (void)best_cycles;
+  printf("null}\n");
+#endif
+  fflush(stdout);
+}
+
+void platform_init() {
+  bench_inputs_init();
+  for (unsigned int i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]);
+       i++) {
+    run_benchmark(&benchmarks[i]);
+  }
+  exit(0);
+}
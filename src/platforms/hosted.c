@@ -139,13 +139,10 @@ size_t console_write(const void *buf, size_t len) {
   if (curtime - last_tx < 50) {
     return 0;
   }
-  struct timespec wait = {
-    .tv_nsec = 100000,
-  };
-  nanosleep(&wait, NULL);
-  ssize_t written = -1;
-  while ((written = write(STDOUT_FILENO, buf, len)) < 0)
-    ;
+  /* stdout is nonblocking, so a reader that falls behind gives EAGAIN rather
+   * than stalling the main loop. The console retries anything not written on
+   * its next pass */
+  ssize_t written = write(STDOUT_FILENO, buf, len);
   if (written > 0) {
     last_tx = curtime;
     return written;
@@ -392,8 +389,9 @@ void platform_init() {
   pthread_mutexattr_settype(&imc_attr, PTHREAD_MUTEX_ERRORCHECK);
   pthread_mutex_init(&interrupt_count_mutex, &imc_attr);
 
-  /* Set stdin nonblock */
+  /* Set stdin and stdout nonblock */
   fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL, 0) | O_NONBLOCK);
+  fcntl(STDOUT_FILENO, F_SETFL, fcntl(STDOUT_FILENO, F_GETFL, 0) | O_NONBLOCK);
 
   pipe(interrupt_pipes);
 
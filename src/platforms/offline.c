@@ -0,0 +1,104 @@
+#include <time.h>
+
+#include "offline.h"
+#include "platform.h"
+
+/* Platform functions shared by the bench and sweep targets, which run the
+ * calculations on the host with no hardware or event loop behind them.
+ * Outputs, timers and config storage do nothing, and time is the host's
+ * monotonic clock. Each target provides its own cycle_count() and
+ * console_read() */
+
+void platform_enable_event_logging() {}
+
+void platform_disable_event_logging() {}
+
+void platform_reset_into_bootloader() {}
+
+void set_pwm(int pin, float val) {
+  (void)pin;
+  (void)val;
+}
+
+void disable_interrupts() {}
+
+void enable_interrupts() {}
+
+int interrupts_enabled() {
+  return 1;
+}
+
+uint64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+timeval_t current_time() {
+  return (timeval_t)(monotonic_ns() / (1000000000 / TICKRATE));
+}
+
+void set_event_timer(timeval_t t) {
+  (void)t;
+}
+
+timeval_t get_event_timer() {
+  return 0;
+}
+
+void clear_event_timer() {}
+
+void disable_event_timer() {}
+
+void set_output(int output, char value) {
+  (void)output;
+  (void)value;
+}
+
+int get_output(int output) {
+  (void)output;
+  return 0;
+}
+
+void set_gpio(int output, char value) {
+  (void)output;
+  (void)value;
+}
+
+int get_gpio(int output) {
+  (void)output;
+  return 0;
+}
+
+void adc_gather(void *_adc) {
+  (void)_adc;
+}
+
+int current_output_buffer() {
+  return 0;
+}
+
+timeval_t init_output_thread(uint32_t *b0, uint32_t *b1, uint32_t len) {
+  (void)b0;
+  (void)b1;
+  (void)len;
+  return 0;
+}
+
+void set_test_trigger_rpm(uint32_t rpm) {
+  (void)rpm;
+}
+
+uint32_t get_test_trigger_rpm() {
+  return 0;
+}
+
+void platform_save_config() {}
+
+void platform_load_config() {}
+
+/* Everything written is taken as sent */
+size_t console_write(const void *ptr, size_t max) {
+  (void)ptr;
+  return max;
+}
@@ -0,0 +1,9 @@
+#ifndef _OFFLINE_H
+#define _OFFLINE_H
+
+#include <stdint.h>
+
+/* Host monotonic clock in nanoseconds, also the source of current_time() */
+uint64_t monotonic_ns();
+
+#endif
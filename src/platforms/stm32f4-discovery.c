@@ -151,16 +151,62 @@ void platform_setup_tim8() {
   TIM8_DIER |= TIM_DIER_UDE; /* Enable update dma */
 }
 
+/* Frequency inputs have each captured edge copied by DMA into their edge ring,
+ * without an interrupt per edge */
+static const struct {
+  uint32_t stream;
+  volatile uint32_t *ccr;
+  uint32_t dier;
+} freq_dma[] = {
+  { DMA_STREAM5, &TIM2_CCR1, TIM_DIER_CC1DE },
+  { DMA_STREAM6, &TIM2_CCR2, TIM_DIER_CC2DE },
+};
+
+static void platform_setup_freq_dma(int input) {
+  /* dma1 stream 5 and 6, channel 3 */
+  uint32_t stream = freq_dma[input].stream;
+  dma_stream_reset(DMA1, stream);
+  dma_set_priority(DMA1, stream, DMA_SxCR_PL_LOW);
+  dma_set_memory_size(DMA1, stream, DMA_SxCR_MSIZE_32BIT);
+  dma_set_peripheral_size(DMA1, stream, DMA_SxCR_PSIZE_32BIT);
+  dma_enable_memory_increment_mode(DMA1, stream);
+  dma_set_transfer_mode(DMA1, stream, DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+  dma_enable_circular_mode(DMA1, stream);
+  dma_set_peripheral_address(DMA1, stream, (uint32_t)freq_dma[input].ccr);
+  dma_set_memory_address(
+    DMA1, stream, (uint32_t)freq_edge_rings[input].edges);
+  dma_set_number_of_data(DMA1, stream, FREQ_EDGE_RING_SIZE);
+  dma_channel_select(DMA1, stream, DMA_SxCR_CHSEL_3);
+  dma_enable_direct_mode(DMA1, stream);
+  dma_enable_stream(DMA1, stream);
+
+  TIM2_DIER |= freq_dma[input].dier;
+}
+
+/* The DMA remaining count gives where the next edge will be written */
+static void platform_update_freq_edge_rings() {
+  for (int i = 0; i < 2; i++) {
+    if (config.freq_inputs[i].type != FREQ) {
+      continue;
+    }
+    uint32_t remaining = dma_get_number_of_data(DMA1, freq_dma[i].stream);
+    freq_edge_ring_advance(&freq_edge_rings[i],
+                           (FREQ_EDGE_RING_SIZE - remaining) %
+                             FREQ_EDGE_RING_SIZE);
+  }
+}
+
 static void platform_init_eventtimer() {
 
   platform_setup_tim2();
 
   /* Only enable interrupts for trigger/sync inputs */
-  if (config.freq_inputs[0].type == TRIGGER) {
-    timer_enable_irq(TIM2, TIM_DIER_CC1IE);
-  }
-  if (config.freq_inputs[1].type == TRIGGER) {
-    timer_enable_irq(TIM2, TIM_DIER_CC2IE);
+  for (int i = 0; i < 2; i++) {
+    if (config.freq_inputs[i].type == TRIGGER) {
+      timer_enable_irq(TIM2, i == 0 ? TIM_DIER_CC1IE : TIM_DIER_CC2IE);
+    } else if (config.freq_inputs[i].type == FREQ) {
+      platform_setup_freq_dma(i);
+    }
   }
 
   nvic_enable_irq(NVIC_TIM2_IRQ);
@@ -793,6 +839,8 @@ void platform_init() {
 }
 
 void sys_tick_handler(void) {
+  platform_update_freq_edge_rings();
+  sensors_process(SENSOR_FREQ);
   run_tasks();
   iwdg_reset();
 }
@@ -901,6 +949,9 @@ void dma1_stream3_isr(void) {
     }
   }
 
+  /* The SPI ADC samples at around 5 kHz, too slow for the knock band, so
+   * knock_add_sample() is not called until the board has a fast input */
+
   sensors_process(SENSOR_ADC);
 
   start_adc_sampling();
@@ -989,21 +1040,26 @@ void tim2_isr() {
   timeval_t cc1;
   timeval_t cc2;
 
-  if (timer_get_flag(TIM2, TIM_SR_CC1IF)) {
+  /* Frequency inputs are captured by DMA, so only trigger inputs are
+   * handled here */
+  bool cc1_trigger = (config.freq_inputs[0].type == TRIGGER);
+  bool cc2_trigger = (config.freq_inputs[1].type == TRIGGER);
+
+  if (cc1_trigger && timer_get_flag(TIM2, TIM_SR_CC1IF)) {
     cc1_fired = true;
     cc1 = TIM2_CCR1;
     timer_clear_flag(TIM2, TIM_SR_CC1IF);
   }
 
-  if (timer_get_flag(TIM2, TIM_SR_CC2IF)) {
+  if (cc2_trigger && timer_get_flag(TIM2, TIM_SR_CC2IF)) {
     cc2_fired = true;
     cc2 = TIM2_CCR2;
     timer_clear_flag(TIM2, TIM_SR_CC2IF);
   }
 
   /* Did we miss a capture event? */
-  if (timer_get_flag(TIM2, TIM_SR_CC1OF) ||
-      timer_get_flag(TIM2, TIM_SR_CC2OF)) {
+  if ((cc1_trigger && timer_get_flag(TIM2, TIM_SR_CC1OF)) ||
+      (cc2_trigger && timer_get_flag(TIM2, TIM_SR_CC2OF))) {
     timer_clear_flag(TIM2, TIM_SR_CC1OF);
     timer_clear_flag(TIM2, TIM_SR_CC2OF);
     decoder_desync(DECODER_OVERFLOW);
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "calculations.h"
+#include "config.h"
+#include "decoder.h"
+#include "offline.h"
+#include "platform.h"
+#include "sensors.h"
+
+/* Offline sweep of the fueling and ignition calculations over a grid of rpm,
+ * MAP, and temperature, using the compiled in config. The grid and output are
+ * configured with environment variables:
+ *
+ * SWEEP_RPM, SWEEP_MAP, SWEEP_TEMP: "start,end,count" for each axis.
+ *   Temperature is applied to both IAT and CLT
+ * SWEEP_BRV: battery voltage for every point
+ * SWEEP_FORMAT: "csv" or "binary"
+ * SWEEP_OUTPUT: output path, defaulting to sweep.csv or sweep.bin
+ * SWEEP_JOBS: number of worker processes, defaulting to the number of cores
+ */
+
+struct sweep_axis {
+  float start;
+  float end;
+  unsigned int count;
+};
+
+/* One record of the binary output, written in native byte order */
+struct sweep_result {
+  float rpm;
+  float map;
+  float temp;
+  float timing_advance;
+  uint32_t dwell_us;
+  uint32_t fueling_us;
+  float ve;
+  float lambda;
+  float ete;
+  float idt;
+};
+
+static struct sweep_axis rpm_axis = { 500, 8000, 76 };
+static struct sweep_axis map_axis = { 20, 250, 47 };
+static struct sweep_axis temp_axis = { -20, 120, 15 };
+static float sweep_brv = 14.0;
+
+timeval_t cycle_count() {
+  return current_time();
+}
+
+size_t console_read(void *ptr, size_t max) {
+  (void)ptr;
+  (void)max;
+  return 0;
+}
+
+static void parse_axis(const char *name, struct sweep_axis *axis) {
+  const char *value = getenv(name);
+  if (!value) {
+    return;
+  }
+  if ((sscanf(value, "%f,%f,%u", &axis->start, &axis->end, &axis->count) !=
+       3) ||
+      (axis->count == 0)) {
+    fprintf(stderr, "%s must be \"start,end,count\"\n", name);
+    exit(1);
+  }
+}
+
+static float axis_value(const struct sweep_axis *axis, unsigned int i) {
+  if (axis->count == 1) {
+    return axis->start;
+  }
+  return axis->start + (axis->end - axis->start) * i / (axis->count - 1);
+}
+
+/* Calculates a single operating point from scratch, so that results don't
+ * depend on the order points are visited or on the input epsilons */
+static void sweep_point(unsigned int index, struct sweep_result *result) {
+  unsigned int m = index % map_axis.count;
+  unsigned int r = (index / map_axis.count) % rpm_axis.count;
+  unsigned int t = index / map_axis.count / rpm_axis.count;
+
+  float rpm = axis_value(&rpm_axis, r);
+  float map = axis_value(&map_axis, m);
+  float temp = axis_value(&temp_axis, t);
+
+  config.decoder.rpm = rpm;
+  sensor_set_value(&config.sensors[SENSOR_MAP], map);
+  sensor_set_value(&config.sensors[SENSOR_IAT], temp);
+  sensor_set_value(&config.sensors[SENSOR_CLT], temp);
+  sensor_set_value(&config.sensors[SENSOR_BRV], sweep_brv);
+  sensor_set_value(&config.sensors[SENSOR_TPS], 0);
+
+  calculations_invalidate();
+  calculate_slow_fueling();
+  calculations_update();
+
+  *result = (struct sweep_result){
+    .rpm = rpm,
+    .map = map,
+    .temp = temp,
+    .timing_advance = calculated_values.timing_advance,
+    .dwell_us = calculated_values.dwell_us,
+    .fueling_us = calculated_values.fueling_us,
+    .ve = calculated_values.ve,
+    .lambda = calculated_values.lambda,
+    .ete = calculated_values.ete,
+    .idt = calculated_values.idt,
+  };
+}
+
+/* Each worker is a forked process with its own copy of the config and
+ * calculation state, writing a contiguous range of the shared results */
+static void run_workers(struct sweep_result *results,
+                        unsigned int points,
+                        unsigned int jobs) {
+  for (unsigned int j = 0; j < jobs; j++) {
+    unsigned int start = (uint64_t)points * j / jobs;
+    unsigned int end = (uint64_t)points * (j + 1) / jobs;
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      exit(1);
+    }
+    if (pid == 0) {
+      for (unsigned int i = start; i < end; i++) {
+        sweep_point(i, &results[i]);
+      }
+      _exit(0);
+    }
+  }
+
+  int failed = 0;
+  int status;
+  while (wait(&status) > 0) {
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+      failed = 1;
+    }
+  }
+  if (failed) {
+    fprintf(stderr, "sweep worker failed\n");
+    exit(1);
+  }
+}
+
+static void write_csv(FILE *f,
+                      const struct sweep_result *results,
+                      unsigned int points) {
+  fprintf(f,
+          "rpm,map,temp,timing_advance,dwell_us,fueling_us,ve,lambda,ete,"
+          "idt\n");
+  for (unsigned int i = 0; i < points; i++) {
+    const struct sweep_result *r = &results[i];
+    fprintf(f,
+            "%g,%g,%g,%g,%u,%u,%g,%g,%g,%g\n",
+            r->rpm,
+            r->map,
+            r->temp,
+            r->timing_advance,
+            (unsigned int)r->dwell_us,
+            (unsigned int)r->fueling_us,
+            r->ve,
+            r->lambda,
+            r->ete,
+            r->idt);
+  }
+}
+
+void platform_init() {
+  parse_axis("SWEEP_RPM", &rpm_axis);
+  parse_axis("SWEEP_MAP", &map_axis);
+  parse_axis("SWEEP_TEMP", &temp_axis);
+  if (getenv("SWEEP_BRV")) {
+    sweep_brv = strtof(getenv("SWEEP_BRV"), NULL);
+  }
+
+  const char *format = getenv("SWEEP_FORMAT") ? getenv("SWEEP_FORMAT") : "csv";
+  int binary = !strcmp(format, "binary");
+  if (!binary && strcmp(format, "csv")) {
+    fprintf(stderr, "SWEEP_FORMAT must be csv or binary\n");
+    exit(1);
+  }
+  const char *path = getenv("SWEEP_OUTPUT");
+  if (!path) {
+    path = binary ? "sweep.bin" : "sweep.csv";
+  }
+
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  if (getenv("SWEEP_JOBS")) {
+    jobs = strtol(getenv("SWEEP_JOBS"), NULL, 10);
+  }
+  if (jobs < 1) {
+    jobs = 1;
+  }
+
+  unsigned int points = rpm_axis.count * map_axis.count * temp_axis.count;
+  size_t size = sizeof(struct sweep_result) * points;
+  struct sweep_result *results = mmap(
+    NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (results == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+
+  /* Constant sensors such as fuel temperature are only processed after
+   * platform_init() */
+  sensors_process(SENSOR_CONST);
+
+  uint64_t start = monotonic_ns();
+  run_workers(results, points, jobs);
+  uint64_t elapsed = monotonic_ns() - start;
+
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    perror(path);
+    exit(1);
+  }
+  if (binary) {
+    fwrite(results, sizeof(struct sweep_result), points, f);
+  } else {
+    write_csv(f, results, points);
+  }
+  fclose(f);
+
+  fprintf(stderr,
+          "swept %u points with %ld jobs in %.3f ms, written to %s\n",
+          points,
+          jobs,
+          elapsed / 1e6,
+          path);
+  exit(0);
+}
@@ -2,9 +2,12 @@
 #include <stdlib.h>
 
 #include "calculations.h"
+#include "capture.h"
 #include "config.h"
 #include "console.h"
 #include "decoder.h"
+#include "fixed.h"
+#include "knock.h"
 #include "platform.h"
 #include "scheduler.h"
 #include "sensors.h"
@@ -145,11 +148,14 @@ void platform_init() {
   Suite *viaems_suite = suite_create("ViaEMS");
 
   suite_add_tcase(viaems_suite, setup_util_tests());
+  suite_add_tcase(viaems_suite, setup_fixed_tests());
   suite_add_tcase(viaems_suite, setup_table_tests());
   suite_add_tcase(viaems_suite, setup_sensor_tests());
+  suite_add_tcase(viaems_suite, setup_capture_tests());
   suite_add_tcase(viaems_suite, setup_decoder_tests());
   suite_add_tcase(viaems_suite, setup_scheduler_tests());
   suite_add_tcase(viaems_suite, setup_calculations_tests());
+  suite_add_tcase(viaems_suite, setup_knock_tests());
   suite_add_tcase(viaems_suite, setup_console_tests());
   suite_add_tcase(viaems_suite, setup_tasks_tests());
   SRunner *sr = srunner_create(viaems_suite);
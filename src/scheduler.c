@@ -381,14 +381,14 @@ static int schedule_ignition_event(struct output_event *ev,
   firing_angle =
     clamp_angle(ev->angle - advance - d->last_trigger_angle + d->offset, 720);
 
-  stop_time = d->last_trigger_time + time_from_rpm_diff(d->rpm, firing_angle);
+  stop_time = d->last_trigger_time + decoder_time_from_degrees(d, firing_angle);
   start_time = stop_time - time_from_us(usecs_dwell);
 
   if (event_has_fired(ev)) {
 
     /* Don't reschedule until we've passed at least 90*/
     if ((time_diff(stop_time, ev->stop.time) <
-         time_from_rpm_diff(d->rpm, 90))) {
+         decoder_time_from_degrees(d, 90))) {
       return 0;
     }
 
@@ -402,7 +402,7 @@ static int schedule_ignition_event(struct output_event *ev,
    * forward once it is scheduled */
   if (ev->stop.scheduled && time_before(ev->stop.time, stop_time) &&
       ((time_diff(stop_time, ev->stop.time) >
-        time_from_rpm_diff(d->rpm, 180)))) {
+        decoder_time_from_degrees(d, 180)))) {
     return 0;
   }
 
@@ -432,14 +432,14 @@ static int schedule_fuel_event(struct output_event *ev,
   firing_angle =
     clamp_angle(ev->angle - d->last_trigger_angle + d->offset, 720);
 
-  stop_time = d->last_trigger_time + time_from_rpm_diff(d->rpm, firing_angle);
+  stop_time = d->last_trigger_time + decoder_time_from_degrees(d, firing_angle);
   start_time = stop_time - (TICKRATE / 1000000) * usecs_pw;
 
   if (event_has_fired(ev)) {
 
     /* Don't reschedule until we've passed at least 90*/
     if ((time_diff(stop_time, ev->stop.time) <
-         time_from_rpm_diff(d->rpm, 90))) {
+         decoder_time_from_degrees(d, 90))) {
       return 0;
     }
 
@@ -455,7 +455,7 @@ static int schedule_fuel_event(struct output_event *ev,
 
   if (ev->stop.scheduled && time_before(ev->stop.time, stop_time) &&
       ((time_diff(stop_time, ev->stop.time) >
-        time_from_rpm_diff(d->rpm, 180)))) {
+        decoder_time_from_degrees(d, 180)))) {
     return 0;
   }
 
@@ -472,16 +472,26 @@ static int schedule_fuel_event(struct output_event *ev,
 }
 
 void schedule_event(struct output_event *ev) {
+  /* Guard against a console change leaving a cylinder out of range */
+  uint32_t cyl = (ev->cylinder < MAX_CYLINDERS) ? ev->cylinder : 0;
+  const struct calculated_values *values = calculations_latest();
+
+  if (!config_is_valid()) {
+    invalidate_scheduled_events(config.events, MAX_EVENTS);
+    return;
+  }
+
   switch (ev->type) {
   case IGNITION_EVENT:
     if (ignition_cut() || !config.decoder.valid) {
       invalidate_scheduled_events(config.events, MAX_EVENTS);
       return;
     }
-    schedule_ignition_event(ev,
-                            &config.decoder,
-                            (degrees_t)calculated_values.timing_advance,
-                            calculated_values.dwell_us);
+    schedule_ignition_event(
+      ev,
+      &config.decoder,
+      (degrees_t)values->cylinder_timing_advance[cyl],
+      values->dwell_us);
     break;
 
   case FUEL_EVENT:
@@ -489,7 +499,7 @@ void schedule_event(struct output_event *ev) {
       invalidate_scheduled_events(config.events, MAX_EVENTS);
       return;
     }
-    schedule_fuel_event(ev, &config.decoder, calculated_values.fueling_us);
+    schedule_fuel_event(ev, &config.decoder, values->cylinder_fueling_us[cyl]);
     break;
 
   default:
@@ -670,6 +680,25 @@ START_TEST(check_schedule_ignition) {
 }
 END_TEST
 
+START_TEST(check_schedule_event_invalid_config) {
+  set_current_time(time_from_rpm_diff(6000, 270));
+  schedule_ignition_event(oev, &config.decoder, 10, 1000);
+  ck_assert(oev->start.scheduled);
+
+  /* Every table is validated, even after an invalid one */
+  config.ve->axis[0].num = MAX_AXIS_SIZE + 1;
+  config.dwell->valid = 0;
+  ck_assert(!config_valid());
+  ck_assert(!config_is_valid());
+  ck_assert(config.dwell->valid);
+
+  /* And nothing is scheduled from an invalid config */
+  schedule_event(oev);
+  ck_assert(!oev->start.scheduled);
+  ck_assert(!oev->stop.scheduled);
+}
+END_TEST
+
 START_TEST(check_schedule_ignition_reschedule_completely_later) {
 
   set_current_time(time_from_rpm_diff(6000, 270));
@@ -1179,6 +1208,7 @@ TCase *setup_scheduler_tests() {
   TCase *tc = tcase_create("scheduler");
   tcase_add_checked_fixture(tc, check_scheduler_setup, NULL);
   tcase_add_test(tc, check_schedule_ignition);
+  tcase_add_test(tc, check_schedule_event_invalid_config);
   tcase_add_test(tc, check_schedule_ignition_reschedule_completely_later);
   tcase_add_test(
     tc, check_schedule_ignition_reschedule_completely_earlier_still_future);
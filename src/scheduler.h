@@ -43,6 +43,7 @@ struct output_event {
   degrees_t angle;
   uint32_t pin;
   uint32_t inverted;
+  uint32_t cylinder; /* Selects per-cylinder trims */
 
   struct sched_entry start;
   struct sched_entry stop;
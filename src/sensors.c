@@ -1,5 +1,7 @@
 #include <math.h>
+#include <string.h>
 
+#include "capture.h"
 #include "config.h"
 #include "decoder.h"
 #include "platform.h"
@@ -11,14 +13,13 @@ static float sensor_convert_linear(struct sensor_input *in, float raw) {
   return in->range.min + partial * (in->range.max - in->range.min);
 }
 
-static int current_angle_in_window(struct sensor_input *in, degrees_t angle) {
+/* Angle past the start of the window period containing angle. Windows repeat
+ * every total_width degrees from the offset, with a total width of 0 taken as
+ * one window per cycle */
+static degrees_t window_position(struct sensor_input *in, degrees_t angle) {
+  uint32_t period = in->window.total_width ? in->window.total_width : 720;
   degrees_t cur_angle = clamp_angle(angle - in->window.offset, 720);
-  for (uint32_t i = 0; i < 720; i += in->window.total_width) {
-    if ((cur_angle >= i) && (cur_angle < i + in->window.capture_width)) {
-      return 1;
-    }
-  }
-  return 0;
+  return cur_angle - period * (uint32_t)(cur_angle / period);
 }
 
 static float sensor_convert_linear_windowed(struct sensor_input *in,
@@ -30,9 +31,11 @@ static float sensor_convert_linear_windowed(struct sensor_input *in,
   }
 
   float result = in->processed_value;
+  degrees_t position = window_position(in, angle);
+  int in_window = position < in->window.capture_width;
 
   /* If not in a window, or we have exceeded a window size */
-  if (!current_angle_in_window(in, angle) ||
+  if (!in_window ||
       clamp_angle(angle - in->window.collection_start_angle, 720) >=
         in->window.capture_width) {
 
@@ -43,10 +46,9 @@ static float sensor_convert_linear_windowed(struct sensor_input *in,
   }
 
   /* Currently in a window. If we just started collecting, initialize */
-  if (current_angle_in_window(in, angle)) {
+  if (in_window) {
     if (!in->window.collecting) {
-      /* TODO: change this to current window start, not current angle */
-      in->window.collection_start_angle = angle;
+      in->window.collection_start_angle = clamp_angle(angle - position, 720);
       in->window.accumulator = 0;
       in->window.samples = 0;
     }
@@ -60,6 +62,59 @@ static float sensor_convert_linear_windowed(struct sensor_input *in,
   return result;
 }
 
+struct freq_edge_ring freq_edge_rings[NUM_FREQ_INPUTS];
+
+void freq_edge_ring_advance(struct freq_edge_ring *ring, uint32_t head) {
+  uint32_t written =
+    (head + FREQ_EDGE_RING_SIZE - ring->head) % FREQ_EDGE_RING_SIZE;
+  uint32_t count = ring->count + written;
+  if (count > FREQ_EDGE_RING_SIZE) {
+    count = FREQ_EDGE_RING_SIZE;
+  }
+  /* Edges must be written before they are visible to readers */
+  __sync_synchronize();
+  ring->count = count;
+  ring->head = head;
+}
+
+void freq_edge_record(uint32_t input, timeval_t time) {
+  struct freq_edge_ring *ring = &freq_edge_rings[input];
+  uint32_t head = ring->head;
+  ring->edges[head] = time;
+  freq_edge_ring_advance(ring, (head + 1) % FREQ_EDGE_RING_SIZE);
+}
+
+uint32_t freq_input_period(uint32_t input) {
+  if (input >= NUM_FREQ_INPUTS) {
+    return 0;
+  }
+  const struct freq_input *f = &config.freq_inputs[input];
+  const struct freq_edge_ring *ring = &freq_edge_rings[input];
+
+  uint32_t periods = f->average_edges;
+  if (periods < 1) {
+    periods = 1;
+  }
+  /* Stay well clear of the slots DMA may be writing before the next update
+   * of head */
+  if (periods > FREQ_EDGE_MAX_PERIODS) {
+    periods = FREQ_EDGE_MAX_PERIODS;
+  }
+
+  uint32_t head = ring->head;
+  if (ring->count <= periods) {
+    return 0;
+  }
+  timeval_t last = ring->edges[(head - 1) % FREQ_EDGE_RING_SIZE];
+  timeval_t first = ring->edges[(head - 1 - periods) % FREQ_EDGE_RING_SIZE];
+
+  if (f->timeout_us &&
+      (time_diff(current_time(), last) > time_from_us(f->timeout_us))) {
+    return 0;
+  }
+  return (last - first) / periods;
+}
+
 static float sensor_convert_freq(float raw) {
   if (!raw) {
     return 0.0; /* Prevent div by zero */
@@ -67,7 +122,8 @@ static float sensor_convert_freq(float raw) {
   return (float)TICKRATE / raw;
 }
 
-float sensor_convert_thermistor(struct thermistor_config *tc, float raw) {
+float sensor_convert_thermistor(const struct thermistor_config *tc,
+                                float raw) {
   stats_start_timing(STATS_SENSOR_THERM_TIME);
   float r = tc->bias / ((4096.0f / raw) - 1);
   float logf_r = logf(r);
@@ -77,77 +133,437 @@ float sensor_convert_thermistor(struct thermistor_config *tc, float raw) {
   return t - 273.15f;
 }
 
-static void sensor_convert(struct sensor_input *in) {
-  /* Handle conn and range fault conditions */
-  if ((in->fault == FAULT_NONE) && (in->fault_config.max != 0)) {
-    if ((in->fault_config.min > in->raw_value) ||
-        (in->fault_config.max < in->raw_value)) {
-      in->fault = FAULT_RANGE;
+void thermistor_table_build(struct thermistor_table *t,
+                            const struct thermistor_config *tc) {
+  t->config = *tc;
+  for (int i = 0; i <= THERMISTOR_TABLE_SEGMENTS; i++) {
+    float raw = i * (4096.0f / THERMISTOR_TABLE_SEGMENTS);
+    t->temperature[i] = sensor_convert_thermistor(&t->config, raw);
+  }
+}
+
+float thermistor_table_lookup(const struct thermistor_table *t, float raw) {
+  float pos = raw * (THERMISTOR_TABLE_SEGMENTS / 4096.0f);
+  /* The conversion diverges at the ends of the ADC range, too steeply to
+   * interpolate, so the end segments are evaluated exactly */
+  if ((pos < 1) || (pos >= THERMISTOR_TABLE_SEGMENTS - 1)) {
+    return sensor_convert_thermistor(&t->config, raw);
+  }
+  int i = pos;
+  float partial = pos - i;
+  return t->temperature[i] +
+         partial * (t->temperature[i + 1] - t->temperature[i]);
+}
+
+static struct thermistor_table thermistor_tables[MAX_THERMISTOR_TABLES];
+
+static float sensor_convert_windowed(struct sensor_input *in, float raw) {
+  return sensor_convert_linear_windowed(in, current_angle(), raw);
+}
+
+static float sensor_convert_table(struct sensor_input *in, float raw) {
+  return interpolate_table_oneaxis(in->table, raw);
+}
+
+static float sensor_convert_therm(struct sensor_input *in, float raw) {
+  if (in->therm_table) {
+    return thermistor_table_lookup(in->therm_table, raw);
+  }
+  return sensor_convert_thermistor(&in->therm, raw);
+}
+
+static float sensor_convert_unknown(struct sensor_input *in, float raw) {
+  (void)raw;
+  return in->processed_value;
+}
+
+static float sensor_raw_adc(float raw) {
+  return raw;
+}
+
+static float sensor_raw_none(float raw) {
+  (void)raw;
+  return 0.0;
+}
+
+static uint32_t sensor_filter_width(const struct sensor_filter_config *f) {
+  if ((f->width == 0) || (f->width > SENSOR_HISTORY_SIZE)) {
+    return SENSOR_HISTORY_SIZE;
+  }
+  return f->width;
+}
+
+void sensor_history_reset(struct sensor_history *h,
+                          const struct sensor_filter_config *f) {
+  *h = (struct sensor_history){ .filter = *f };
+
+  /* RBJ cookbook low pass with a Q of 1/sqrt(2) */
+  if ((f->type == FILTER_LOWPASS) && (f->cutoff > 0) && (f->cutoff < 0.5f)) {
+    float w0 = 2 * 3.14159265f * f->cutoff;
+    float cos_w0 = cosf(w0);
+    float alpha = sinf(w0) / (2 * 0.70710678f);
+    float a0 = 1 + alpha;
+    h->b0 = (1 - cos_w0) / 2 / a0;
+    h->b1 = (1 - cos_w0) / a0;
+    h->b2 = h->b0;
+    h->a1 = -2 * cos_w0 / a0;
+    h->a2 = (1 - alpha) / a0;
+  } else {
+    /* Pass through */
+    h->b0 = 1;
+  }
+}
+
+static void sorted_remove(float *sorted, uint32_t count, float value) {
+  uint32_t i = 0;
+  while ((i < count - 1) && (sorted[i] != value)) {
+    i++;
+  }
+  for (; i < count - 1; i++) {
+    sorted[i] = sorted[i + 1];
+  }
+}
+
+static void sorted_insert(float *sorted, uint32_t count, float value) {
+  uint32_t i = count;
+  while ((i > 0) && (sorted[i - 1] > value)) {
+    sorted[i] = sorted[i - 1];
+    i--;
+  }
+  sorted[i] = value;
+}
+
+/* Recompute the running sums from the ring, so that float error can't
+ * accumulate. Done once per pass around the ring */
+static void sensor_history_resum(struct sensor_history *h) {
+  uint32_t width = sensor_filter_width(&h->filter);
+  h->sum = 0;
+  h->weighted_sum = 0;
+  h->window_sum = 0;
+  for (uint32_t i = 0; i < h->count; i++) {
+    uint32_t idx = (h->head + SENSOR_HISTORY_SIZE - h->count + i) %
+                   SENSOR_HISTORY_SIZE;
+    h->sum += h->filtered[idx];
+    h->weighted_sum += i * h->filtered[idx];
+    if (i + width >= h->count) {
+      h->window_sum += h->values[idx];
     }
   }
-  if (in->fault != FAULT_NONE) {
-    in->processed_value = in->fault_config.fault_value;
-    return;
+}
+
+float sensor_history_add(struct sensor_history *h,
+                         timeval_t time,
+                         float value) {
+  uint32_t width = sensor_filter_width(&h->filter);
+  uint32_t window = (h->count < width) ? h->count : width;
+
+  /* Remove the sample leaving the filter window, before it may be
+   * overwritten */
+  if (window == width) {
+    float leaving =
+      h->values[(h->head + SENSOR_HISTORY_SIZE - width) % SENSOR_HISTORY_SIZE];
+    h->window_sum -= leaving;
+    if (h->filter.type == FILTER_MEDIAN) {
+      sorted_remove(h->sorted, window, leaving);
+    }
+    window--;
   }
+  h->window_sum += value;
+  if (h->filter.type == FILTER_MEDIAN) {
+    sorted_insert(h->sorted, window, value);
+  }
+  window++;
 
-  float raw;
-  switch (in->source) {
-  case SENSOR_ADC:
-    raw = in->raw_value;
+  float filtered;
+  switch (h->filter.type) {
+  case FILTER_AVERAGE:
+    filtered = h->window_sum / window;
     break;
-  case SENSOR_FREQ:
-    raw = sensor_convert_freq(in->raw_value);
+  case FILTER_MEDIAN:
+    if (window % 2) {
+      filtered = h->sorted[window / 2];
+    } else {
+      filtered = (h->sorted[window / 2 - 1] + h->sorted[window / 2]) / 2;
+    }
+    break;
+  case FILTER_LOWPASS:
+    if (h->count == 0) {
+      /* Start from steady state rather than zero */
+      h->x1 = h->x2 = h->y1 = h->y2 = value;
+    }
+    filtered = h->b0 * value + h->b1 * h->x1 + h->b2 * h->x2 - h->a1 * h->y1 -
+               h->a2 * h->y2;
+    h->x2 = h->x1;
+    h->x1 = value;
+    h->y2 = h->y1;
+    h->y1 = filtered;
     break;
-  case SENSOR_CONST:
-    in->processed_value = in->fixed_value;
-    return;
   default:
-    raw = 0.0;
+    filtered = value;
     break;
   }
 
-  switch (in->method) {
+  /* Slide the least squares sums of the filtered values, with the oldest at
+   * position 0 */
+  if (h->count == SENSOR_HISTORY_SIZE) {
+    float oldest = h->filtered[h->head];
+    h->weighted_sum -= h->sum - oldest;
+    h->weighted_sum += (SENSOR_HISTORY_SIZE - 1) * filtered;
+    h->sum += filtered - oldest;
+  } else {
+    h->weighted_sum += h->count * filtered;
+    h->sum += filtered;
+    h->count++;
+  }
+
+  h->values[h->head] = value;
+  h->filtered[h->head] = filtered;
+  h->times[h->head] = time;
+  h->head = (h->head + 1) % SENSOR_HISTORY_SIZE;
+  if (h->head == 0) {
+    sensor_history_resum(h);
+  }
+
+  return filtered;
+}
+
+float sensor_history_slope(const struct sensor_history *h) {
+  if (h->count < 2) {
+    return 0;
+  }
+  float n = h->count;
+  uint32_t newest = (h->head + SENSOR_HISTORY_SIZE - 1) % SENSOR_HISTORY_SIZE;
+  uint32_t oldest =
+    (h->head + SENSOR_HISTORY_SIZE - h->count) % SENSOR_HISTORY_SIZE;
+  timeval_t span = h->times[newest] - h->times[oldest];
+  if (!span) {
+    return 0;
+  }
+
+  /* Positions are 0 to n-1, so their sums are known */
+  float sum_x = n * (n - 1) / 2;
+  float sum_xx = (n - 1) * n * (2 * n - 1) / 6;
+  float per_sample =
+    (n * h->weighted_sum - sum_x * h->sum) / (n * sum_xx - sum_x * sum_x);
+
+  /* Samples are taken at a steady rate, so use the mean interval */
+  return per_sample * (n - 1) * TICKRATE / span;
+}
+
+typedef float (*sensor_raw_func)(float raw);
+typedef float (*sensor_convert_func)(struct sensor_input *, float raw);
+
+/* Conversion from each source's raw value to the input to a method */
+static const sensor_raw_func sensor_raw_funcs[NUM_SENSOR_SOURCES] = {
+  [SENSOR_NONE] = sensor_raw_none,
+  [SENSOR_ADC] = sensor_raw_adc,
+  [SENSOR_FREQ] = sensor_convert_freq,
+  [SENSOR_DIGITAL] = sensor_raw_none,
+  [SENSOR_CONST] = sensor_raw_none,
+};
+
+/* Raw samples summed towards a decimated sensor's next conversion, and the
+ * input they were taken from */
+struct sensor_accumulator {
+  uint32_t sum;
+  uint32_t samples;
+
+  sensor_source source;
+  uint32_t pin;
+  uint32_t decimation;
+};
+
+/* Sensors of each source, with the conversion for their method. Constant
+ * sensors have no conversion */
+struct sensor_source_list {
+  uint32_t count;
+  struct sensor_input *inputs[NUM_SENSORS];
+  sensor_convert_func convert[NUM_SENSORS];
+  struct sensor_history *history[NUM_SENSORS];
+  uint32_t decimation[NUM_SENSORS];
+  struct sensor_accumulator *accumulator[NUM_SENSORS];
+};
+
+static struct sensor_source_list sensor_source_lists[NUM_SENSOR_SOURCES];
+static struct sensor_history sensor_histories[NUM_SENSORS];
+static struct sensor_accumulator sensor_accumulators[NUM_SENSORS];
+
+static sensor_convert_func sensor_method_convert(sensor_method method) {
+  switch (method) {
   case METHOD_LINEAR:
-    in->processed_value = sensor_convert_linear(in, raw);
-    break;
+    return sensor_convert_linear;
   case METHOD_LINEAR_WINDOWED:
-    in->processed_value =
-      sensor_convert_linear_windowed(in, current_angle(), raw);
-    break;
+    return sensor_convert_windowed;
   case METHOD_TABLE:
-    in->processed_value = interpolate_table_oneaxis(in->table, raw);
-    break;
+    return sensor_convert_table;
   case METHOD_THERM:
-    in->processed_value = sensor_convert_thermistor(&in->therm, raw);
-    break;
+    return sensor_convert_therm;
   }
+  return sensor_convert_unknown;
+}
+
+static int sensor_uses_thermistor_table(const struct sensor_input *in) {
+  /* Tables span the ADC range, so can't be used for other sources */
+  return (in->source == SENSOR_ADC) && (in->method == METHOD_THERM);
+}
 
-  /* Do lag filtering over 10ish ms derivative window */
-  in->processed_value = ((in->derivative.last_sample_value * in->lag) +
-                         (in->processed_value * (100.0f - in->lag))) /
-                        100.0f;
+void sensors_reconfigure() {
+  struct sensor_source_list lists[NUM_SENSOR_SOURCES] = { 0 };
+  const struct thermistor_table *therm_tables[NUM_SENSORS] = { 0 };
+  int reset[NUM_SENSORS] = { 0 };
+  int reset_accumulator[NUM_SENSORS] = { 0 };
+  uint32_t decimation[NUM_SENSORS];
+
+  int n_tables = 0;
+
+  for (int i = 0; i < NUM_SENSORS; ++i) {
+    struct sensor_input *in = &config.sensors[i];
+    if (sensor_uses_thermistor_table(in) &&
+        (n_tables < MAX_THERMISTOR_TABLES)) {
+      /* Only rebuild tables whose thermistor config has changed. Each is
+       * built on the stack and copied in while interrupts are off. Until the
+       * lists are swapped below, a sensor that has moved to another table may
+       * briefly read this one */
+      struct thermistor_table *t = &thermistor_tables[n_tables];
+      if (memcmp(&t->config, &in->therm, sizeof(in->therm))) {
+        struct thermistor_table rebuilt;
+        thermistor_table_build(&rebuilt, &in->therm);
+        disable_interrupts();
+        *t = rebuilt;
+        enable_interrupts();
+      }
+      therm_tables[i] = t;
+      n_tables++;
+    }
+
+    /* History is kept across reconfiguration unless the filter changed, and
+     * is then reset in place below */
+    if (memcmp(&sensor_histories[i].filter, &in->filter, sizeof(in->filter))) {
+      reset[i] = 1;
+    }
+
+    /* As are partial sums, unless they were taken from another input or
+     * towards a different count */
+    decimation[i] =
+      ((in->decimation > 1) && (in->method != METHOD_LINEAR_WINDOWED))
+        ? in->decimation
+        : 1;
+    const struct sensor_accumulator *acc = &sensor_accumulators[i];
+    if ((acc->source != in->source) || (acc->pin != in->pin) ||
+        (acc->decimation != decimation[i])) {
+      reset_accumulator[i] = 1;
+    }
+
+    if (in->source >= NUM_SENSOR_SOURCES) {
+      continue;
+    }
+    struct sensor_source_list *list = &lists[in->source];
+    list->inputs[list->count] = in;
+    list->convert[list->count] =
+      (in->source == SENSOR_CONST) ? NULL : sensor_method_convert(in->method);
+    list->history[list->count] = &sensor_histories[i];
+    list->decimation[list->count] = decimation[i];
+    list->accumulator[list->count] = &sensor_accumulators[i];
+    list->count++;
+  }
+
+  /* Sensors may be processed from interrupts */
+  disable_interrupts();
+  for (int i = 0; i < NUM_SENSORS; ++i) {
+    config.sensors[i].therm_table = therm_tables[i];
+    if (reset[i]) {
+      sensor_history_reset(&sensor_histories[i], &config.sensors[i].filter);
+    }
+    if (reset_accumulator[i]) {
+      sensor_accumulators[i] = (struct sensor_accumulator){
+        .source = config.sensors[i].source,
+        .pin = config.sensors[i].pin,
+        .decimation = decimation[i],
+      };
+    }
+  }
+  memcpy(sensor_source_lists, lists, sizeof(lists));
+  enable_interrupts();
+}
+
+void sensor_set_value(struct sensor_input *in, float value) {
+  in->processed_value = value;
+  in->processed_fixed = fixed_from_float(value);
+}
+
+static void sensor_convert(struct sensor_input *in,
+                           sensor_raw_func raw_func,
+                           sensor_convert_func convert,
+                           struct sensor_history *history) {
+  /* Handle conn and range fault conditions */
+  if ((in->fault == FAULT_NONE) && (in->fault_config.max != 0)) {
+    if ((in->fault_config.min > in->raw_value) ||
+        (in->fault_config.max < in->raw_value)) {
+      in->fault = FAULT_RANGE;
+    }
+  }
+  if (in->fault != FAULT_NONE) {
+    sensor_set_value(in, in->fault_config.fault_value);
+    return;
+  }
+
+  if (!convert) {
+    sensor_set_value(in, in->fixed_value);
+    return;
+  }
 
-  /* Process derivative */
   timeval_t process_time = current_time();
+  float value = convert(in, raw_func(in->raw_value));
+  value = sensor_history_add(history, process_time, value);
+
+  /* Do lag filtering over 10ish ms window */
+  sensor_set_value(in,
+                   ((in->derivative.last_sample_value * in->lag) +
+                    (value * (100.0f - in->lag))) /
+                     100.0f);
 
-  /* We want derivatives at a minimum of 10 ms dt to keep noise at a minimum */
   if (process_time - in->derivative.last_sample_time > time_from_us(10000)) {
-    in->derivative.value =
-      TICKRATE * (in->processed_value - in->derivative.last_sample_value) /
-      (process_time - in->derivative.last_sample_time);
     in->derivative.last_sample_time = process_time;
     in->derivative.last_sample_value = in->processed_value;
   }
+
+  /* Fit over the recent samples rather than differencing two, to keep noise
+   * at a minimum */
+  in->derivative.value = sensor_history_slope(history);
 }
 
 void sensors_process(sensor_source source) {
-  for (int i = 0; i < NUM_SENSORS; ++i) {
-    if (config.sensors[i].source != source) {
-      continue;
+  if (source >= NUM_SENSOR_SOURCES) {
+    return;
+  }
+  const struct sensor_source_list *list = &sensor_source_lists[source];
+  sensor_raw_func raw_func = sensor_raw_funcs[source];
+  if (source == SENSOR_ADC) {
+    /* Before conversion, so the angle is as close to the samples as possible */
+    capture_record();
+  }
+  if (source == SENSOR_FREQ) {
+    for (uint32_t i = 0; i < list->count; ++i) {
+      list->inputs[i]->raw_value = freq_input_period(list->inputs[i]->pin);
     }
-    sensor_convert(&config.sensors[i]);
+  }
+  for (uint32_t i = 0; i < list->count; ++i) {
+    struct sensor_input *in = list->inputs[i];
+    if (list->decimation[i] > 1) {
+      struct sensor_accumulator *acc = list->accumulator[i];
+      acc->sum += in->raw_value;
+      acc->samples++;
+      if (acc->samples < list->decimation[i]) {
+        continue;
+      }
+      in->raw_value = acc->sum / acc->samples;
+      acc->sum = 0;
+      acc->samples = 0;
+    }
+    sensor_convert(in, raw_func, list->convert[i], list->history[i]);
   }
 }
+
 uint32_t sensor_fault_status() {
   uint32_t faults = 0;
   for (int i = 0; i < NUM_SENSORS; ++i) {
@@ -272,12 +688,9 @@ START_TEST(check_sensor_convert_linear_windowed_wide) {
   ck_assert_float_eq_tol(
     sensor_convert_linear_windowed(&si, 130, 1500), 12, 0.1);
 
-  /* TODO: right now this needs to be capture_width degrees past the first
-   * sample in the last window, which is not ideal. We should just treat all
-   * samples in the window as acceptable */
   /* Reaches end of window, should average all three prior samples */
   ck_assert_float_eq_tol(
-    sensor_convert_linear_windowed(&si, 210, 2000), 1733.33, 0.1);
+    sensor_convert_linear_windowed(&si, 180, 2000), 1733.33, 0.1);
 }
 END_TEST
 
@@ -314,6 +727,28 @@ START_TEST(check_sensor_convert_linear_windowed_offset) {
 }
 END_TEST
 
+START_TEST(check_sensor_convert_linear_windowed_late_start) {
+  struct sensor_input si = {
+    .processed_value = 12.0,
+    .range = { .min=0, .max=4096.0},
+    .window = {
+      .total_width = 90,
+      .capture_width = 90,
+    },
+  };
+
+  config.decoder.rpm = 1000;
+
+  /* First sample is late in the window, which still ends at 90 degrees */
+  ck_assert_float_eq_tol(
+    sensor_convert_linear_windowed(&si, 60, 2048), 12.0, 0.01);
+  ck_assert_float_eq_tol(
+    sensor_convert_linear_windowed(&si, 80, 2600), 12.0, 0.01);
+  ck_assert_float_eq_tol(
+    sensor_convert_linear_windowed(&si, 100, 2700), 2324, 0.1);
+}
+END_TEST
+
 START_TEST(check_sensor_convert_freq) {
   ck_assert_float_eq_tol(sensor_convert_freq(100.0), 40000, .1);
 
@@ -323,6 +758,84 @@ START_TEST(check_sensor_convert_freq) {
 }
 END_TEST
 
+START_TEST(check_freq_input_period) {
+  config.freq_inputs[3] = (struct freq_input){
+    .type = FREQ,
+    .average_edges = 4,
+    .timeout_us = 1000,
+  };
+
+  /* Not enough edges yet */
+  set_current_time(1000);
+  freq_edge_record(3, 1000);
+  freq_edge_record(3, 1110);
+  ck_assert_int_eq(freq_input_period(3), 0);
+
+  /* Jittery edges are averaged, across the wrap of the ring */
+  timeval_t t = 1110;
+  for (int i = 0; i < FREQ_EDGE_RING_SIZE + 2; i++) {
+    t += (i % 2) ? 90 : 110;
+    freq_edge_record(3, t);
+  }
+  set_current_time(t);
+  ck_assert_int_eq(freq_input_period(3), 100);
+
+  config.freq_inputs[3].average_edges = 1;
+  ck_assert_int_eq(freq_input_period(3), 90);
+
+  /* Too long since the last edge */
+  set_current_time(t + time_from_us(1000) + 1);
+  ck_assert_int_eq(freq_input_period(3), 0);
+  config.freq_inputs[3].timeout_us = 0;
+  ck_assert_int_eq(freq_input_period(3), 90);
+
+  /* Averaging is capped to half of the ring */
+  config.freq_inputs[3].average_edges = FREQ_EDGE_RING_SIZE - 1;
+  for (int i = 0; i < FREQ_EDGE_MAX_PERIODS; i++) {
+    t += 100;
+    freq_edge_record(3, t);
+  }
+  t += 1000;
+  freq_edge_record(3, t);
+  set_current_time(t);
+  ck_assert_int_eq(freq_input_period(3),
+                   (100 * (FREQ_EDGE_MAX_PERIODS - 1) + 1000) /
+                     FREQ_EDGE_MAX_PERIODS);
+}
+END_TEST
+
+START_TEST(check_freq_input_period_edge_at_zero) {
+  config.freq_inputs[3] = (struct freq_input){
+    .type = FREQ,
+    .average_edges = 1,
+  };
+
+  /* A capture of 0 is a valid edge time */
+  freq_edge_record(3, 0);
+  ck_assert_int_eq(freq_input_period(3), 0);
+  freq_edge_record(3, 100);
+  set_current_time(100);
+  ck_assert_int_eq(freq_input_period(3), 100);
+
+  /* Edges written by DMA are counted as head advances */
+  struct freq_edge_ring *ring = &freq_edge_rings[2];
+  ring->edges[0] = 200;
+  ring->edges[1] = 300;
+  ring->edges[2] = 450;
+  freq_edge_ring_advance(ring, 1);
+  ck_assert_int_eq(ring->count, 1);
+  ck_assert_int_eq(freq_input_period(2), 0);
+  freq_edge_ring_advance(ring, 3);
+  ck_assert_int_eq(ring->count, 3);
+  config.freq_inputs[2] = (struct freq_input){
+    .type = FREQ,
+    .average_edges = 2,
+  };
+  set_current_time(450);
+  ck_assert_int_eq(freq_input_period(2), 125);
+}
+END_TEST
+
 START_TEST(check_sensor_convert_therm) {
   // test parameters for my CHT sensor
   struct thermistor_config tc = {
@@ -338,6 +851,179 @@ START_TEST(check_sensor_convert_therm) {
 }
 END_TEST
 
+START_TEST(check_thermistor_table_accuracy) {
+  struct thermistor_config tc = {
+    .bias = 2490.0,
+    .a = 0.00131586818223649,
+    .b = 0.000256187001401003,
+    .c = 1.84741994569279E-07,
+  };
+  struct thermistor_table t;
+  thermistor_table_build(&t, &tc);
+
+  /* Worst case error over the full 12 bit range is near the ends, in
+   * temperatures no engine sensor would see */
+  float worst = 0;
+  float worst_in_range = 0;
+  for (int raw = 1; raw < 4096; raw++) {
+    float exact = sensor_convert_thermistor(&tc, raw);
+    float error = fabsf(thermistor_table_lookup(&t, raw) - exact);
+    if (error > worst) {
+      worst = error;
+    }
+    if ((exact >= -40) && (exact <= 150) && (error > worst_in_range)) {
+      worst_in_range = error;
+    }
+  }
+  ck_assert_float_le(worst_in_range, 0.2);
+  ck_assert_float_le(worst, 5.0);
+}
+END_TEST
+
+START_TEST(check_sensors_reconfigure_thermistor_table) {
+  for (int i = 0; i < NUM_SENSORS; ++i) {
+    config.sensors[i] = (struct sensor_input){ .source = SENSOR_NONE };
+  }
+  struct thermistor_config tc = {
+    .bias = 2490.0,
+    .a = 0.00131586818223649,
+    .b = 0.000256187001401003,
+    .c = 1.84741994569279E-07,
+  };
+  config.sensors[SENSOR_CLT] = (struct sensor_input){
+    .source = SENSOR_ADC,
+    .method = METHOD_THERM,
+    .therm = tc,
+    .raw_value = 2048,
+  };
+  config.sensors[SENSOR_IAT] = (struct sensor_input){
+    .source = SENSOR_FREQ,
+    .method = METHOD_THERM,
+    .therm = tc,
+  };
+  sensors_reconfigure();
+
+  ck_assert_ptr_nonnull(config.sensors[SENSOR_CLT].therm_table);
+  ck_assert_ptr_null(config.sensors[SENSOR_IAT].therm_table);
+
+  sensors_process(SENSOR_ADC);
+  ck_assert_float_eq_tol(
+    config.sensors[SENSOR_CLT].processed_value, 20.31, 0.2);
+
+  /* A changed config rebuilds the table */
+  config.sensors[SENSOR_CLT].therm.bias = 4980.0;
+  sensors_reconfigure();
+  sensors_process(SENSOR_ADC);
+  ck_assert_float_eq_tol(config.sensors[SENSOR_CLT].processed_value,
+                         sensor_convert_thermistor(
+                           &config.sensors[SENSOR_CLT].therm, 2048),
+                         0.2);
+}
+END_TEST
+
+START_TEST(check_sensor_filter_average) {
+  struct sensor_history h;
+  sensor_history_reset(
+    &h, &(struct sensor_filter_config){ .type = FILTER_AVERAGE, .width = 4 });
+
+  ck_assert_float_eq(sensor_history_add(&h, 0, 4), 4);
+  ck_assert_float_eq(sensor_history_add(&h, 1, 8), 6);
+  sensor_history_add(&h, 2, 0);
+  ck_assert_float_eq(sensor_history_add(&h, 3, 4), 4);
+  /* First sample leaves the window */
+  ck_assert_float_eq(sensor_history_add(&h, 4, 12), 6);
+
+  /* Still exact after passing around the ring several times */
+  for (int i = 0; i < 3 * SENSOR_HISTORY_SIZE; i++) {
+    sensor_history_add(&h, 5 + i, i % 2 ? 1.1 : 2.3);
+  }
+  ck_assert_float_eq_tol(sensor_history_add(&h, 100, 1.1), 1.4, 0.0001);
+}
+END_TEST
+
+START_TEST(check_sensor_filter_median) {
+  struct sensor_history h;
+  sensor_history_reset(
+    &h, &(struct sensor_filter_config){ .type = FILTER_MEDIAN, .width = 3 });
+
+  ck_assert_float_eq(sensor_history_add(&h, 0, 10), 10);
+  ck_assert_float_eq(sensor_history_add(&h, 1, 12), 11);
+  ck_assert_float_eq(sensor_history_add(&h, 2, 11), 11);
+
+  /* A single spike is rejected */
+  ck_assert_float_eq(sensor_history_add(&h, 3, 500), 12);
+  ck_assert_float_eq(sensor_history_add(&h, 4, 11), 11);
+  ck_assert_float_eq(sensor_history_add(&h, 5, 13), 13);
+  ck_assert_float_eq(sensor_history_add(&h, 6, 12), 12);
+}
+END_TEST
+
+START_TEST(check_sensor_filter_lowpass) {
+  struct sensor_history h;
+  sensor_history_reset(&h,
+                       &(struct sensor_filter_config){
+                         .type = FILTER_LOWPASS,
+                         .cutoff = 0.05,
+                       });
+
+  /* Starts at the first sample, and settles to a step without a large
+   * overshoot */
+  ck_assert_float_eq_tol(sensor_history_add(&h, 0, 10), 10, 0.0001);
+  float max = 0;
+  float y = 0;
+  for (int i = 1; i < 200; i++) {
+    y = sensor_history_add(&h, i, 20);
+    if (y > max) {
+      max = y;
+    }
+  }
+  ck_assert_float_eq_tol(y, 20, 0.001);
+  ck_assert_float_lt(max, 20.5);
+
+  /* Alternating input at the sample rate is attenuated */
+  for (int i = 0; i < 200; i++) {
+    y = sensor_history_add(&h, 200 + i, i % 2 ? 21 : 19);
+  }
+  ck_assert_float_eq_tol(y, 20, 0.05);
+}
+END_TEST
+
+START_TEST(check_sensor_history_slope) {
+  struct sensor_history h;
+  sensor_history_reset(&h, &(struct sensor_filter_config){ 0 });
+
+  ck_assert_float_eq(sensor_history_slope(&h), 0);
+
+  /* A ramp of 2 per ms, across several passes around the ring */
+  for (int i = 0; i < 3 * SENSOR_HISTORY_SIZE + 5; i++) {
+    sensor_history_add(&h, time_from_us(1000 * i), 2 * i);
+    if (i > 0) {
+      ck_assert_float_eq_tol(sensor_history_slope(&h), 2000, 1);
+    }
+  }
+
+  /* Noise about a constant has little slope */
+  for (int i = 0; i < SENSOR_HISTORY_SIZE; i++) {
+    sensor_history_add(&h, time_from_us(1000 * i), (i % 2) ? 1 : -1);
+  }
+  ck_assert_float_eq_tol(sensor_history_slope(&h), 0, 150);
+
+  /* The fit is over the filtered values, so filtering removes the noise from
+   * the slope too */
+  sensor_history_reset(
+    &h, &(struct sensor_filter_config){ .type = FILTER_AVERAGE, .width = 2 });
+  for (int i = 0; i < 2 * SENSOR_HISTORY_SIZE; i++) {
+    float noise = (i % 2) ? 50 : -50;
+    sensor_history_add(&h, time_from_us(1000 * i), 2 * i + noise);
+  }
+  ck_assert_float_eq_tol(sensor_history_slope(&h), 2000, 1);
+}
+END_TEST
+
+static int current_angle_in_window(struct sensor_input *in, degrees_t angle) {
+  return window_position(in, angle) < in->window.capture_width;
+}
+
 START_TEST(check_current_angle_in_window) {
   struct sensor_input in = {
     .window = {
@@ -356,6 +1042,127 @@ START_TEST(check_current_angle_in_window) {
 
   ck_assert(!current_angle_in_window(&in, 690));
   ck_assert(current_angle_in_window(&in, 710));
+
+  /* Partial last window */
+  in.window.total_width = 200;
+  ck_assert(current_angle_in_window(&in, 610));
+  ck_assert(!current_angle_in_window(&in, 660));
+  ck_assert(current_angle_in_window(&in, 0));
+
+  in.window.offset = 30;
+  ck_assert(!current_angle_in_window(&in, 20));
+  ck_assert(current_angle_in_window(&in, 30));
+  ck_assert(current_angle_in_window(&in, 89));
+  ck_assert(!current_angle_in_window(&in, 90));
+}
+END_TEST
+
+START_TEST(check_sensors_process_by_source) {
+  for (int i = 0; i < NUM_SENSORS; ++i) {
+    config.sensors[i] = (struct sensor_input){ .source = SENSOR_NONE };
+  }
+  config.sensors[SENSOR_MAP] = (struct sensor_input){
+    .source = SENSOR_ADC,
+    .method = METHOD_LINEAR,
+    .range = { .min = 0, .max = 4096 },
+    .raw_value = 1000,
+  };
+  config.sensors[SENSOR_FRT] = (struct sensor_input){
+    .source = SENSOR_CONST,
+    .fixed_value = 15.0,
+  };
+  sensors_reconfigure();
+
+  sensors_process(SENSOR_CONST);
+  ck_assert_float_eq(config.sensors[SENSOR_FRT].processed_value, 15.0);
+  ck_assert_int_eq(config.sensors[SENSOR_FRT].processed_fixed,
+                   fixed_from_int(15));
+  ck_assert_float_eq(config.sensors[SENSOR_MAP].processed_value, 0.0);
+
+  sensors_process(SENSOR_ADC);
+  ck_assert_float_eq_tol(
+    config.sensors[SENSOR_MAP].processed_value, 1000, 0.01);
+  ck_assert_int_eq(
+    config.sensors[SENSOR_MAP].processed_fixed,
+    fixed_from_float(config.sensors[SENSOR_MAP].processed_value));
+
+  /* A changed source takes effect once reconfigured */
+  config.sensors[SENSOR_MAP].source = SENSOR_FREQ;
+  config.sensors[SENSOR_MAP].pin = 2;
+  config.freq_inputs[2].average_edges = 1;
+  freq_edge_record(2, 1000);
+  freq_edge_record(2, 1100);
+  set_current_time(1100);
+  sensors_process(SENSOR_FREQ);
+  ck_assert_float_eq_tol(
+    config.sensors[SENSOR_MAP].processed_value, 1000, 0.01);
+
+  sensors_reconfigure();
+  sensors_process(SENSOR_FREQ);
+  ck_assert_float_eq_tol(
+    config.sensors[SENSOR_MAP].processed_value, 40000, 0.1);
+}
+END_TEST
+
+START_TEST(check_sensors_decimation) {
+  for (int i = 0; i < NUM_SENSORS; ++i) {
+    config.sensors[i] = (struct sensor_input){ .source = SENSOR_NONE };
+  }
+  config.sensors[SENSOR_TPS] = (struct sensor_input){
+    .source = SENSOR_ADC,
+    .method = METHOD_LINEAR,
+    .range = { .min = 0, .max = 4096 },
+  };
+  config.sensors[SENSOR_CLT] = (struct sensor_input){
+    .source = SENSOR_ADC,
+    .method = METHOD_LINEAR,
+    .range = { .min = 0, .max = 4096 },
+    .decimation = 4,
+  };
+  sensors_reconfigure();
+
+  /* Decimated sensors are converted from the mean of every fourth set of
+   * samples, others from each sample */
+  for (int i = 0; i < 3; ++i) {
+    config.sensors[SENSOR_TPS].raw_value = 1000 + i;
+    config.sensors[SENSOR_CLT].raw_value = 1000 + i;
+    sensors_process(SENSOR_ADC);
+    ck_assert_float_eq_tol(
+      config.sensors[SENSOR_TPS].processed_value, 1000 + i, 0.01);
+    ck_assert_float_eq(config.sensors[SENSOR_CLT].processed_value, 0.0);
+  }
+  /* Reconfiguring without changing the input keeps the partial sum */
+  config.sensors[SENSOR_TPS].pin = 3;
+  sensors_reconfigure();
+  config.sensors[SENSOR_CLT].raw_value = 1005;
+  sensors_process(SENSOR_ADC);
+  ck_assert_float_eq_tol(
+    config.sensors[SENSOR_CLT].processed_value, 1002, 0.01);
+
+  /* Changing it starts again */
+  for (int i = 0; i < 2; ++i) {
+    config.sensors[SENSOR_CLT].raw_value = 3000;
+    sensors_process(SENSOR_ADC);
+  }
+  config.sensors[SENSOR_CLT].pin = 3;
+  sensors_reconfigure();
+  for (int i = 0; i < 3; ++i) {
+    config.sensors[SENSOR_CLT].raw_value = 1000;
+    sensors_process(SENSOR_ADC);
+  }
+  ck_assert_float_eq_tol(
+    config.sensors[SENSOR_CLT].processed_value, 1002, 0.01);
+  config.sensors[SENSOR_CLT].raw_value = 1000;
+  sensors_process(SENSOR_ADC);
+  ck_assert_float_lt(config.sensors[SENSOR_CLT].processed_value, 1002);
+
+  /* Windowed sensors need every sample */
+  config.sensors[SENSOR_CLT].method = METHOD_LINEAR_WINDOWED;
+  sensors_reconfigure();
+  config.sensors[SENSOR_CLT].raw_value = 2000;
+  sensors_process(SENSOR_ADC);
+  ck_assert_float_eq_tol(
+    config.sensors[SENSOR_CLT].processed_value, 2000, 0.01);
 }
 END_TEST
 
@@ -366,8 +1173,20 @@ TCase *setup_sensor_tests() {
   tcase_add_test(sensor_tests, check_sensor_convert_linear_windowed_skipped);
   tcase_add_test(sensor_tests, check_sensor_convert_linear_windowed_wide);
   tcase_add_test(sensor_tests, check_sensor_convert_linear_windowed_offset);
+  tcase_add_test(sensor_tests,
+                 check_sensor_convert_linear_windowed_late_start);
   tcase_add_test(sensor_tests, check_sensor_convert_freq);
+  tcase_add_test(sensor_tests, check_freq_input_period);
+  tcase_add_test(sensor_tests, check_freq_input_period_edge_at_zero);
   tcase_add_test(sensor_tests, check_sensor_convert_therm);
+  tcase_add_test(sensor_tests, check_thermistor_table_accuracy);
+  tcase_add_test(sensor_tests, check_sensors_reconfigure_thermistor_table);
+  tcase_add_test(sensor_tests, check_sensors_process_by_source);
+  tcase_add_test(sensor_tests, check_sensors_decimation);
+  tcase_add_test(sensor_tests, check_sensor_filter_average);
+  tcase_add_test(sensor_tests, check_sensor_filter_median);
+  tcase_add_test(sensor_tests, check_sensor_filter_lowpass);
+  tcase_add_test(sensor_tests, check_sensor_history_slope);
 
   tcase_add_test(sensor_tests, check_current_angle_in_window);
   return sensor_tests;
@@ -1,6 +1,7 @@
 #ifndef _SENSORS_H
 #define _SENSORS_H
 
+#include "fixed.h"
 #include "platform.h"
 #define SENSOR_FREQ_DIVIDER 4096
 
@@ -23,6 +24,7 @@ typedef enum {
   SENSOR_FREQ,
   SENSOR_DIGITAL,
   SENSOR_CONST,
+  NUM_SENSOR_SOURCES,
 } sensor_source;
 
 typedef enum {
@@ -32,6 +34,42 @@ typedef enum {
   METHOD_THERM,
 } sensor_method;
 
+typedef enum {
+  FILTER_NONE,
+  FILTER_AVERAGE, /* Moving average of the last width samples */
+  FILTER_MEDIAN,  /* Median of the last width samples */
+  FILTER_LOWPASS, /* Second order Butterworth low pass */
+} sensor_filter;
+
+/* Number of recent samples kept per sensor, for filters and the derivative */
+#define SENSOR_HISTORY_SIZE 16
+
+struct sensor_filter_config {
+  sensor_filter type;
+  uint32_t width; /* Samples for average and median, up to history size */
+  float cutoff;   /* Low pass cutoff as a fraction of the sample rate */
+};
+
+/* Ring of a sensor's recent samples and their filtered values, with the
+ * running state of its filter and of the least squares fit over the filtered
+ * values used for its derivative */
+struct sensor_history {
+  struct sensor_filter_config filter;
+  float values[SENSOR_HISTORY_SIZE];
+  float filtered[SENSOR_HISTORY_SIZE];
+  timeval_t times[SENSOR_HISTORY_SIZE];
+  uint32_t head; /* Next index to write */
+  uint32_t count;
+
+  float window_sum;                  /* Last filter.width values */
+  float sorted[SENSOR_HISTORY_SIZE]; /* Last filter.width values, sorted */
+  float sum;                         /* All filtered values */
+  float weighted_sum; /* Filtered values weighted by position, oldest 0 */
+
+  float b0, b1, b2, a1, a2; /* Low pass coefficients */
+  float x1, x2, y1, y2;     /* Low pass state */
+};
+
 typedef enum {
   FAULT_NONE,
   FAULT_RANGE,
@@ -43,6 +81,16 @@ struct thermistor_config {
   float a, b, c;
 };
 
+/* Thermistor temperatures tabulated over the ADC range, for ADC thermistor
+ * sensors to interpolate rather than evaluate per sample */
+#define THERMISTOR_TABLE_SEGMENTS 256
+#define MAX_THERMISTOR_TABLES 4
+
+struct thermistor_table {
+  struct thermistor_config config; /* Config the table was built from */
+  float temperature[THERMISTOR_TABLE_SEGMENTS + 1];
+};
+
 struct sensor_input {
   uint32_t pin;
   sensor_source source;
@@ -55,8 +103,15 @@ struct sensor_input {
   struct table *table;
   float fixed_value;
   struct thermistor_config therm;
+  /* Set by sensors_reconfigure(), otherwise the exact conversion is used */
+  const struct thermistor_table *therm_table;
 
   float lag;
+  struct sensor_filter_config filter;
+  /* Raw samples averaged per conversion, for slow sensors that needn't be
+   * converted at the full sample rate. 0 or 1 converts every sample, and
+   * windowed sensors always do */
+  uint32_t decimation;
   struct {
     uint32_t min;
     uint32_t max;
@@ -75,6 +130,7 @@ struct sensor_input {
 
   uint32_t raw_value;
   float processed_value;
+  fixed_t processed_fixed; /* processed_value in Q16.16 */
   struct {
     timeval_t last_sample_time;
     float last_sample_value;
@@ -97,9 +153,56 @@ typedef enum {
 struct freq_input {
   trigger_edge edge;
   freq_type type;
+  uint32_t average_edges; /* Periods averaged for the frequency */
+  uint32_t timeout_us;    /* No edge for this long is 0 Hz, 0 is no timeout */
+};
+
+#define NUM_FREQ_INPUTS 4
+
+/* Edge times kept for each frequency input, a power of two */
+#define FREQ_EDGE_RING_SIZE 32
+#define FREQ_EDGE_MAX_PERIODS (FREQ_EDGE_RING_SIZE / 2)
+
+/* Recent edge times of a frequency input. Filled by the platform, either
+ * with freq_edge_record() from an edge interrupt, or by DMA from the capture
+ * register followed by freq_edge_ring_advance() before
+ * sensors_process(SENSOR_FREQ) */
+struct freq_edge_ring {
+  timeval_t edges[FREQ_EDGE_RING_SIZE];
+  volatile uint32_t head;  /* Index the next edge is written to */
+  volatile uint32_t count; /* Edges written, up to FREQ_EDGE_RING_SIZE */
 };
 
+extern struct freq_edge_ring freq_edge_rings[NUM_FREQ_INPUTS];
+
 void sensors_process(sensor_source source);
+/* Sets a sensor's processed value along with its fixed point copy, for values
+ * that don't come from sensors_process() */
+void sensor_set_value(struct sensor_input *, float value);
+
+/* Moves head to where the next edge will be written, counting the edges
+ * written since the last advance. A whole lap of the ring in between isn't
+ * seen, which only matters before the ring first fills */
+void freq_edge_ring_advance(struct freq_edge_ring *, uint32_t head);
+void freq_edge_record(uint32_t input, timeval_t time);
+/* Mean period in ticks over the input's most recent average_edges periods (at
+ * most FREQ_EDGE_MAX_PERIODS), or
+ * 0 if there aren't enough edges or the last is stale */
+uint32_t freq_input_period(uint32_t input);
+
+void sensor_history_reset(struct sensor_history *,
+                          const struct sensor_filter_config *);
+/* Adds a sample, returning the filtered value */
+float sensor_history_add(struct sensor_history *, timeval_t, float value);
+/* Least squares slope of the filtered samples, per second */
+float sensor_history_slope(const struct sensor_history *);
+/* Rebuild the per-source sensor lists and conversions used by
+ * sensors_process(), after sensor config has changed */
+void sensors_reconfigure();
+float sensor_convert_thermistor(const struct thermistor_config *, float raw);
+void thermistor_table_build(struct thermistor_table *,
+                            const struct thermistor_config *);
+float thermistor_table_lookup(const struct thermistor_table *, float raw);
 uint32_t sensor_fault_status();
 
 #ifdef UNITTEST
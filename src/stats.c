@@ -44,9 +44,15 @@ struct stats_entry stats_entries[] = {
 	[STATS_SENSOR_THERM_TIME] = {
 		.name = "sensor_therm_time",
 	},
+	[STATS_CAPTURE_TIME] = {
+		.name = "capture_time",
+	},
 	[STATS_FUELCALC_TIME] = {
 		.name = "fuelcalc_time",
 	},
+	[STATS_SLOW_FUELCALC_TIME] = {
+		.name = "slow_fuelcalc_time",
+	},
   [STATS_INT_TOTAL_TIME] = {
     .name = "total interrupt time",
     .is_interrupt = 1,
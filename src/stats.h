@@ -24,7 +24,9 @@ typedef enum {
   STATS_INT_TOTAL_TIME,
   STATS_INT_TESTTRIGGER_TIME,
   STATS_FUELCALC_TIME,
+  STATS_SLOW_FUELCALC_TIME,
   STATS_SENSOR_THERM_TIME,
+  STATS_CAPTURE_TIME,
   STATS_DECODE_TIME,
   STATS_SCHED_TOTAL_TIME,
   STATS_SCHED_FIRED_TIME,
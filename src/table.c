@@ -1,79 +1,336 @@
 #include "table.h"
 
-float interpolate_table_oneaxis(struct table *t, float val) {
-  if (t->num_axis != 1) {
-    while (1)
-      ;
-  }
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct table_bin {
+  int index;
+  float partial;
+};
+
+/* Clamp val to the precomputed range of an axis and find the segment it falls
+ * in, along with its fractional position within that segment */
+static struct table_bin table_axis_bin(const struct table *t,
+                                       int axis,
+                                       float val) {
+  const struct table_axis *a = &t->axis[axis];
+  struct table_bin bin = { 0, 0.0f };
   /* Clamp to bottom */
-  if (val < t->axis[0].values[0]) {
-    val = t->axis[0].values[0];
+  if (val < t->bounds[axis].min) {
+    val = t->bounds[axis].min;
   }
   /* Clamp to top */
-  if (val > t->axis[0].values[t->axis[0].num - 1]) {
-    val = t->axis[0].values[t->axis[0].num - 1];
-  }
-  for (int x = 0; x < t->axis[0].num - 1; ++x) {
-    float first_axis = t->axis[0].values[x];
-    float second_axis = t->axis[0].values[x + 1];
-    if ((val >= first_axis) && (val <= second_axis)) {
-      float partial = (val - first_axis) / (second_axis - first_axis);
-      float first_val = t->data.one[x];
-      float second_val = t->data.one[x + 1];
-      return ((second_val - first_val) * partial) + first_val;
-    }
+  if (val > t->bounds[axis].max) {
+    val = t->bounds[axis].max;
+  }
+  while ((bin.index < a->num - 2) && (val > a->values[bin.index + 1])) {
+    bin.index++;
+  }
+  float first_axis = a->values[bin.index];
+  float second_axis = a->values[bin.index + 1];
+  if (second_axis > first_axis) {
+    bin.partial = (val - first_axis) / (second_axis - first_axis);
   }
-  return 0;
+  return bin;
+}
+
+static float lerp(float first, float second, float partial) {
+  return ((second - first) * partial) + first;
+}
+
+static float interpolate_bins(const float *first_row,
+                              const float *second_row,
+                              struct table_bin x,
+                              struct table_bin y) {
+  float xy1 = lerp(first_row[x.index], first_row[x.index + 1], x.partial);
+  float xy2 = lerp(second_row[x.index], second_row[x.index + 1], x.partial);
+  return lerp(xy1, xy2, y.partial);
+}
+
+float interpolate_table_oneaxis_unchecked(const struct table *t, float val) {
+  struct table_bin x = table_axis_bin(t, 0, val);
+  return lerp(t->data.one[x.index], t->data.one[x.index + 1], x.partial);
+}
+
+float interpolate_table_twoaxis_unchecked(const struct table *t,
+                                          float x,
+                                          float y) {
+  struct table_bin xbin = table_axis_bin(t, 0, x);
+  struct table_bin ybin = table_axis_bin(t, 1, y);
+  return interpolate_bins(t->data.two[ybin.index],
+                          t->data.two[ybin.index + 1],
+                          xbin,
+                          ybin);
+}
+
+void interpolate_table_twoaxis_partial(const struct table *t,
+                                       float x,
+                                       float *partial) {
+  struct table_bin xbin = table_axis_bin(t, 0, x);
+  for (int i = 0; i < t->axis[1].num; i++) {
+    partial[i] = lerp(
+      t->data.two[i][xbin.index], t->data.two[i][xbin.index + 1], xbin.partial);
+  }
+}
+
+float interpolate_table_twoaxis_complete(const struct table *t,
+                                         const float *partial,
+                                         float y) {
+  struct table_bin ybin = table_axis_bin(t, 1, y);
+  return lerp(partial[ybin.index], partial[ybin.index + 1], ybin.partial);
+}
+
+float interpolate_table_threeaxis_unchecked(const struct table *t,
+                                            float x,
+                                            float y,
+                                            float z) {
+  struct table_bin xbin = table_axis_bin(t, 0, x);
+  struct table_bin ybin = table_axis_bin(t, 1, y);
+  struct table_bin zbin = table_axis_bin(t, 2, z);
+  float xyz1 = interpolate_bins(t->data.three[zbin.index][ybin.index],
+                                t->data.three[zbin.index][ybin.index + 1],
+                                xbin,
+                                ybin);
+  float xyz2 = interpolate_bins(t->data.three[zbin.index + 1][ybin.index],
+                                t->data.three[zbin.index + 1][ybin.index + 1],
+                                xbin,
+                                ybin);
+  return lerp(xyz1, xyz2, zbin.partial);
+}
+
+void interpolate_table_threeaxis_layers_unchecked(const struct table *t,
+                                                  float x,
+                                                  float y,
+                                                  float *out) {
+  struct table_bin xbin = table_axis_bin(t, 0, x);
+  struct table_bin ybin = table_axis_bin(t, 1, y);
+  for (int z = 0; z < t->axis[2].num; z++) {
+    out[z] = interpolate_bins(t->data.three[z][ybin.index],
+                              t->data.three[z][ybin.index + 1],
+                              xbin,
+                              ybin);
+  }
+}
+
+struct table_bin_fixed {
+  int index;
+  fixed_t partial;
+};
+
+static struct table_bin_fixed table_axis_bin_fixed(const struct table_fixed *t,
+                                                   int axis,
+                                                   int num,
+                                                   fixed_t val) {
+  const fixed_t *values = t->values[axis];
+  struct table_bin_fixed bin = { 0, 0 };
+  if (val < t->bounds[axis].min) {
+    val = t->bounds[axis].min;
+  }
+  if (val > t->bounds[axis].max) {
+    val = t->bounds[axis].max;
+  }
+  while ((bin.index < num - 2) && (val > values[bin.index + 1])) {
+    bin.index++;
+  }
+  fixed_t first_axis = values[bin.index];
+  fixed_t second_axis = values[bin.index + 1];
+  if (second_axis > first_axis) {
+    bin.partial = fixed_div(val - first_axis, second_axis - first_axis);
+  }
+  return bin;
+}
+
+static fixed_t lerp_fixed(fixed_t first, fixed_t second, fixed_t partial) {
+  int64_t diff = (int64_t)second - first;
+  return fixed_saturate(first + fixed_descale(diff * partial));
+}
+
+static fixed_t interpolate_bins_fixed(const fixed_t *first_row,
+                                      const fixed_t *second_row,
+                                      struct table_bin_fixed x,
+                                      struct table_bin_fixed y) {
+  fixed_t xy1 =
+    lerp_fixed(first_row[x.index], first_row[x.index + 1], x.partial);
+  fixed_t xy2 =
+    lerp_fixed(second_row[x.index], second_row[x.index + 1], x.partial);
+  return lerp_fixed(xy1, xy2, y.partial);
+}
+
+fixed_t interpolate_table_oneaxis_fixed(const struct table *t, fixed_t val) {
+  const struct table_fixed *f = t->fixed;
+  struct table_bin_fixed x = table_axis_bin_fixed(f, 0, t->axis[0].num, val);
+  return lerp_fixed(f->data.one[x.index], f->data.one[x.index + 1], x.partial);
+}
+
+fixed_t interpolate_table_twoaxis_fixed(const struct table *t,
+                                        fixed_t x,
+                                        fixed_t y) {
+  const struct table_fixed *f = t->fixed;
+  struct table_bin_fixed xbin = table_axis_bin_fixed(f, 0, t->axis[0].num, x);
+  struct table_bin_fixed ybin = table_axis_bin_fixed(f, 1, t->axis[1].num, y);
+  return interpolate_bins_fixed(
+    f->data.two[ybin.index], f->data.two[ybin.index + 1], xbin, ybin);
+}
+
+fixed_t interpolate_table_threeaxis_fixed(const struct table *t,
+                                          fixed_t x,
+                                          fixed_t y,
+                                          fixed_t z) {
+  const struct table_fixed *f = t->fixed;
+  struct table_bin_fixed xbin = table_axis_bin_fixed(f, 0, t->axis[0].num, x);
+  struct table_bin_fixed ybin = table_axis_bin_fixed(f, 1, t->axis[1].num, y);
+  struct table_bin_fixed zbin = table_axis_bin_fixed(f, 2, t->axis[2].num, z);
+  fixed_t xyz1 =
+    interpolate_bins_fixed(f->data.three[zbin.index][ybin.index],
+                           f->data.three[zbin.index][ybin.index + 1],
+                           xbin,
+                           ybin);
+  fixed_t xyz2 =
+    interpolate_bins_fixed(f->data.three[zbin.index + 1][ybin.index],
+                           f->data.three[zbin.index + 1][ybin.index + 1],
+                           xbin,
+                           ybin);
+  return lerp_fixed(xyz1, xyz2, zbin.partial);
+}
+
+void interpolate_table_threeaxis_layers_fixed(const struct table *t,
+                                              fixed_t x,
+                                              fixed_t y,
+                                              fixed_t *out) {
+  const struct table_fixed *f = t->fixed;
+  struct table_bin_fixed xbin = table_axis_bin_fixed(f, 0, t->axis[0].num, x);
+  struct table_bin_fixed ybin = table_axis_bin_fixed(f, 1, t->axis[1].num, y);
+  for (int z = 0; z < t->axis[2].num; z++) {
+    out[z] = interpolate_bins_fixed(f->data.three[z][ybin.index],
+                                    f->data.three[z][ybin.index + 1],
+                                    xbin,
+                                    ybin);
+  }
+}
+
+fixed_t interpolate_table_twoaxis_complete_fixed(const struct table *t,
+                                                 const fixed_t *partial,
+                                                 fixed_t y) {
+  struct table_bin_fixed ybin =
+    table_axis_bin_fixed(t->fixed, 1, t->axis[1].num, y);
+  return lerp_fixed(partial[ybin.index], partial[ybin.index + 1], ybin.partial);
+}
+
+/* Returns true if the table is valid and has the expected number of axis,
+ * validating it first if it has not been already */
+static int table_usable(struct table *t, uint32_t num_axis) {
+  if (!t->valid && !table_valid(t)) {
+    return 0;
+  }
+  return t->num_axis == num_axis;
+}
+
+float interpolate_table_oneaxis(struct table *t, float val) {
+  if (!table_usable(t, 1)) {
+    return 0;
+  }
+  return interpolate_table_oneaxis_unchecked(t, val);
 }
 
 float interpolate_table_twoaxis(struct table *t, float x, float y) {
-  float x1 = 0, x2 = 0, y1 = 0, y2 = 0;
-  int x1_ind = 0, y1_ind = 0;
-  float xy1, xy2, xy;
-  if (t->num_axis != 2) {
-    while (1)
-      ;
-  }
-  /* Clamp X to bottom */
-  if (x < t->axis[0].values[0]) {
-    x = t->axis[0].values[0];
-  }
-  /* Clamp X to top */
-  if (x > t->axis[0].values[t->axis[0].num - 1]) {
-    x = t->axis[0].values[t->axis[0].num - 1];
-  }
-  /* Clamp Y to bottom */
-  if (y < t->axis[1].values[0]) {
-    y = t->axis[1].values[0];
-  }
-  /* Clamp Y to top */
-  if (y > t->axis[1].values[t->axis[1].num - 1]) {
-    y = t->axis[1].values[t->axis[1].num - 1];
-  }
-  for (x1_ind = 0; x1_ind < t->axis[0].num - 1; ++x1_ind) {
-    x1 = t->axis[0].values[x1_ind];
-    x2 = t->axis[0].values[x1_ind + 1];
-    if ((x >= x1) && (x <= x2)) {
-      break;
-    }
+  if (!table_usable(t, 2)) {
+    return 0;
   }
-  for (y1_ind = 0; y1_ind < t->axis[1].num - 1; ++y1_ind) {
-    y1 = t->axis[1].values[y1_ind];
-    y2 = t->axis[1].values[y1_ind + 1];
-    if ((y >= y1) && (y <= y2)) {
-      break;
+  return interpolate_table_twoaxis_unchecked(t, x, y);
+}
+
+float interpolate_table_threeaxis(struct table *t, float x, float y, float z) {
+  if (!table_usable(t, 3)) {
+    return 0;
+  }
+  return interpolate_table_threeaxis_unchecked(t, x, y, z);
+}
+
+#if defined(__SSE2__)
+/* SSE2 version of table_axis_bin() for four values at once. Performs the same
+ * float operations in the same order so that results are identical. */
+static __m128 table_axis_bin_sse(const struct table *t,
+                                 int axis,
+                                 __m128 val,
+                                 int32_t index[4]) {
+  const struct table_axis *a = &t->axis[axis];
+
+  /* Operand order matches the scalar clamp's handling of NaN */
+  val = _mm_max_ps(_mm_set1_ps(t->bounds[axis].min), val);
+  val = _mm_min_ps(_mm_set1_ps(t->bounds[axis].max), val);
+
+  /* Count the interior axis values each value is above */
+  __m128i bin = _mm_setzero_si128();
+  for (int i = 1; i < a->num - 1; i++) {
+    __m128 above = _mm_cmpgt_ps(val, _mm_set1_ps(a->values[i]));
+    bin = _mm_sub_epi32(bin, _mm_castps_si128(above));
+  }
+  _mm_storeu_si128((__m128i *)index, bin);
+
+  float first[4], second[4];
+  for (int i = 0; i < 4; i++) {
+    first[i] = a->values[index[i]];
+    second[i] = a->values[index[i] + 1];
+  }
+  __m128 first_axis = _mm_loadu_ps(first);
+  __m128 second_axis = _mm_loadu_ps(second);
+  __m128 partial = _mm_div_ps(_mm_sub_ps(val, first_axis),
+                              _mm_sub_ps(second_axis, first_axis));
+  return _mm_and_ps(partial, _mm_cmpgt_ps(second_axis, first_axis));
+}
+
+static __m128 lerp_sse(__m128 first, __m128 second, __m128 partial) {
+  return _mm_add_ps(_mm_mul_ps(_mm_sub_ps(second, first), partial), first);
+}
+
+static void interpolate_table_twoaxis_sse(const struct table *t,
+                                          const float *x,
+                                          const float *y,
+                                          float *out) {
+  int32_t xi[4], yi[4];
+  __m128 xpartial = table_axis_bin_sse(t, 0, _mm_loadu_ps(x), xi);
+  __m128 ypartial = table_axis_bin_sse(t, 1, _mm_loadu_ps(y), yi);
+
+  float c00[4], c01[4], c10[4], c11[4];
+  for (int i = 0; i < 4; i++) {
+    c00[i] = t->data.two[yi[i]][xi[i]];
+    c01[i] = t->data.two[yi[i]][xi[i] + 1];
+    c10[i] = t->data.two[yi[i] + 1][xi[i]];
+    c11[i] = t->data.two[yi[i] + 1][xi[i] + 1];
+  }
+  __m128 xy1 = lerp_sse(_mm_loadu_ps(c00), _mm_loadu_ps(c01), xpartial);
+  __m128 xy2 = lerp_sse(_mm_loadu_ps(c10), _mm_loadu_ps(c11), xpartial);
+  _mm_storeu_ps(out, lerp_sse(xy1, xy2, ypartial));
+}
+#endif
+
+void interpolate_table_twoaxis_batch(struct table *t,
+                                     const float *x,
+                                     const float *y,
+                                     float *out,
+                                     int n) {
+  int i = 0;
+  if (!table_usable(t, 2)) {
+    for (; i < n; i++) {
+      out[i] = 0;
     }
+    return;
+  }
+#if defined(__SSE2__)
+  for (; i + 4 <= n; i += 4) {
+    interpolate_table_twoaxis_sse(t, &x[i], &y[i], &out[i]);
+  }
+#endif
+  /* Scalar reference path, and remainder of vectorized path */
+  for (; i < n; i++) {
+    out[i] = interpolate_table_twoaxis_unchecked(t, x[i], y[i]);
   }
-  xy1 = (x2 - x) / (x2 - x1) * t->data.two[y1_ind][x1_ind] +
-        (x - x1) / (x2 - x1) * t->data.two[y1_ind][x1_ind + 1];
-  xy2 = (x2 - x) / (x2 - x1) * t->data.two[y1_ind + 1][x1_ind] +
-        (x - x1) / (x2 - x1) * t->data.two[y1_ind + 1][x1_ind + 1];
-  xy = (y2 - y) / (y2 - y1) * xy1 + (y - y1) / (y2 - y1) * xy2;
-  return xy;
 }
 
-static int table_valid_axis(struct table_axis *a) {
-  if (a->num > MAX_AXIS_SIZE) {
+static int table_valid_axis(struct table_axis *a, int max_size) {
+  /* Need at least two points to interpolate between */
+  if ((a->num < 2) || (a->num > max_size)) {
     return 0;
   }
   for (int i = 0; i < a->num - 1; i++) {
@@ -84,25 +341,77 @@ static int table_valid_axis(struct table_axis *a) {
   return 1;
 }
 
+#ifdef FIXED_POINT_CALCULATIONS
+/* Converts a valid table's axis and data for the fixed point lookups */
+static void table_update_fixed(struct table *t) {
+  struct table_fixed *f = t->fixed;
+  for (unsigned int i = 0; i < t->num_axis; i++) {
+    for (int j = 0; j < t->axis[i].num; j++) {
+      f->values[i][j] = fixed_from_float(t->axis[i].values[j]);
+    }
+    f->bounds[i].min = f->values[i][0];
+    f->bounds[i].max = f->values[i][t->axis[i].num - 1];
+  }
+
+  const struct table_axis *a = t->axis;
+  switch (t->num_axis) {
+  case 1:
+    for (int x = 0; x < a[0].num; x++) {
+      f->data.one[x] = fixed_from_float(t->data.one[x]);
+    }
+    break;
+  case 2:
+    for (int y = 0; y < a[1].num; y++) {
+      for (int x = 0; x < a[0].num; x++) {
+        f->data.two[y][x] = fixed_from_float(t->data.two[y][x]);
+      }
+    }
+    break;
+  case 3:
+    for (int z = 0; z < a[2].num; z++) {
+      for (int y = 0; y < a[1].num; y++) {
+        for (int x = 0; x < a[0].num; x++) {
+          f->data.three[z][y][x] = fixed_from_float(t->data.three[z][y][x]);
+        }
+      }
+    }
+    break;
+  }
+}
+#endif
+
 int table_valid(struct table *t) {
+  t->valid = 0;
 
-  if ((t->num_axis != 1) && (t->num_axis != 2)) {
+  if ((t->num_axis < 1) || (t->num_axis > 3)) {
     return 0;
   }
 
-  if (!table_valid_axis(&t->axis[0])) {
-    return 0;
+  /* Three axis tables share storage with two axis tables, so are limited
+   * to a smaller size */
+  int max_size = (t->num_axis == 3) ? MAX_3D_AXIS_SIZE : MAX_AXIS_SIZE;
+  for (unsigned int i = 0; i < t->num_axis; i++) {
+    if (!table_valid_axis(&t->axis[i], max_size)) {
+      return 0;
+    }
+    t->bounds[i].min = t->axis[i].values[0];
+    t->bounds[i].max = t->axis[i].values[t->axis[i].num - 1];
   }
 
-  if ((t->num_axis == 2) && !table_valid_axis(&t->axis[1])) {
-    return 0;
+#ifdef FIXED_POINT_CALCULATIONS
+  if (t->fixed) {
+    table_update_fixed(t);
   }
+#endif
 
+  t->valid = 1;
   return 1;
 }
 
 #ifdef UNITTEST
 #include <check.h>
+#include <math.h>
+#include <string.h>
 
 static struct table t1 = {
   .num_axis = 1,
@@ -130,6 +439,26 @@ static struct table t2 = {
    },
 };
 
+static struct table t3 = {
+  .num_axis = 3,
+  .axis = { {
+    .num = 3,
+    .values = {0, 10, 20},
+   }, {
+    .num = 2,
+    .values = {100, 200},
+   }, {
+    .num = 2,
+    .values = {-10, 10},
+  } },
+  .data = {
+    .three = { { {0, 10, 20},
+                 {100, 110, 120} },
+               { {1000, 1010, 1020},
+                 {1100, 1110, 1120} } },
+  },
+};
+
 START_TEST(check_table_oneaxis_interpolate) {
   ck_assert(interpolate_table_oneaxis(&t1, 7.5) == 75);
   ck_assert(interpolate_table_oneaxis(&t1, 5) == 50);
@@ -161,12 +490,219 @@ START_TEST(check_table_twoaxis_clamp) {
 }
 END_TEST
 
+START_TEST(check_table_threeaxis_interpolate) {
+  ck_assert(interpolate_table_threeaxis(&t3, 0, 100, -10) == 0);
+  ck_assert(interpolate_table_threeaxis(&t3, 5, 100, -10) == 5);
+  ck_assert(interpolate_table_threeaxis(&t3, 10, 150, -10) == 60);
+  ck_assert(interpolate_table_threeaxis(&t3, 10, 100, 0) == 510);
+  ck_assert(interpolate_table_threeaxis(&t3, 15, 150, 0) == 565);
+  ck_assert(interpolate_table_threeaxis(&t3, 20, 200, 10) == 1120);
+}
+END_TEST
+
+START_TEST(check_table_threeaxis_clamp) {
+  ck_assert(interpolate_table_threeaxis(&t3, -5, 50, -20) == 0);
+  ck_assert(interpolate_table_threeaxis(&t3, 30, 300, 20) == 1120);
+  ck_assert(interpolate_table_threeaxis(&t3, 30, 150, -20) == 70);
+}
+END_TEST
+
+START_TEST(check_table_valid) {
+  ck_assert(table_valid(&t1));
+  ck_assert(table_valid(&t2));
+  ck_assert(table_valid(&t3));
+
+  struct table t = t3;
+  t.axis[2].values[1] = -20;
+  ck_assert(!table_valid(&t));
+
+  t = t3;
+  t.axis[0].num = MAX_3D_AXIS_SIZE + 1;
+  ck_assert(!table_valid(&t));
+
+  t = t3;
+  t.num_axis = 4;
+  ck_assert(!table_valid(&t));
+
+  t = t1;
+  t.axis[0].num = 1;
+  ck_assert(!table_valid(&t));
+}
+END_TEST
+
+START_TEST(check_table_invalid_lookup) {
+  struct table t = t2;
+  t.axis[1].values[0] = 0;
+  ck_assert(interpolate_table_twoaxis(&t, 7.5, -45) == 0);
+  ck_assert(!t.valid);
+
+  /* Lookups with the wrong number of axis are rejected */
+  ck_assert(interpolate_table_oneaxis(&t2, 7.5) == 0);
+  ck_assert(interpolate_table_threeaxis(&t2, 7.5, -45, 0) == 0);
+}
+END_TEST
+
+START_TEST(check_table_unchecked_lookup) {
+  ck_assert(table_valid(&t1));
+  ck_assert(table_valid(&t2));
+  ck_assert(table_valid(&t3));
+  ck_assert(t2.bounds[1].min == -50);
+  ck_assert(t2.bounds[1].max == -20);
+
+  for (float x = 0; x < 25; x += 0.25) {
+    ck_assert(interpolate_table_oneaxis_unchecked(&t1, x) ==
+              interpolate_table_oneaxis(&t1, x));
+    for (float y = -60; y < 0; y += 2.5) {
+      ck_assert(interpolate_table_twoaxis_unchecked(&t2, x, y) ==
+                interpolate_table_twoaxis(&t2, x, y));
+      ck_assert(interpolate_table_threeaxis_unchecked(&t3, x, y + 200, y) ==
+                interpolate_table_threeaxis(&t3, x, y + 200, y));
+    }
+  }
+}
+END_TEST
+
+START_TEST(check_table_twoaxis_batch) {
+  struct table t = t2;
+  /* Repeated axis value */
+  t.axis[1].values[2] = -40;
+
+  float x[103], y[103], out[103];
+  for (int i = 0; i < 103; i++) {
+    x[i] = 2.0f + 0.19f * i;
+    y[i] = -55.0f + 0.37f * (i % 97);
+  }
+  x[5] = 10;
+  y[5] = -40;
+  y[6] = NAN;
+
+  interpolate_table_twoaxis_batch(&t, x, y, out, 103);
+  for (int i = 0; i < 103; i++) {
+    float expected = interpolate_table_twoaxis(&t, x[i], y[i]);
+    ck_assert(memcmp(&out[i], &expected, sizeof(float)) == 0);
+  }
+
+  /* Invalid tables give zeros */
+  t.num_axis = 1;
+  interpolate_table_twoaxis_batch(&t, x, y, out, 103);
+  ck_assert(out[0] == 0);
+  ck_assert(out[102] == 0);
+}
+END_TEST
+
+START_TEST(check_table_twoaxis_partial) {
+  struct table t = t2;
+  ck_assert(table_valid(&t));
+
+  float partial[MAX_AXIS_SIZE];
+  for (float x = 0; x < 30; x += 0.7f) {
+    interpolate_table_twoaxis_partial(&t, x, partial);
+    for (float y = -60; y < 60; y += 1.3f) {
+      float expected = interpolate_table_twoaxis_unchecked(&t, x, y);
+      float result = interpolate_table_twoaxis_complete(&t, partial, y);
+      ck_assert(memcmp(&result, &expected, sizeof(float)) == 0);
+    }
+  }
+}
+END_TEST
+
+START_TEST(check_table_threeaxis_layers) {
+  struct table t = {
+    .num_axis = 3,
+    .axis = { { .num = 3, .values = { 10, 20, 30 } },
+              { .num = 2, .values = { 0, 100 } },
+              { .num = 3, .values = { 0, 1, 2 } } },
+    .data = { .three = { { { 1, 2, 3 }, { 4, 5, 6 } },
+                         { { 0, 0, 0 }, { 10, 10, 10 } },
+                         { { -1, -1, -1 }, { -2, -2, -2 } } } },
+  };
+  ck_assert(table_valid(&t));
+
+  float out[MAX_3D_AXIS_SIZE];
+  for (float x = 0; x < 40; x += 1.7f) {
+    for (float y = -10; y < 110; y += 6.1f) {
+      interpolate_table_threeaxis_layers_unchecked(&t, x, y, out);
+      for (int z = 0; z < 3; z++) {
+        float expected = interpolate_table_threeaxis_unchecked(&t, x, y, z);
+        ck_assert_float_eq_tol(out[z], expected, 0.00001);
+      }
+    }
+  }
+
+#ifdef FIXED_POINT_CALCULATIONS
+  struct table_fixed fixed;
+  t.fixed = &fixed;
+  ck_assert(table_valid(&t));
+
+  fixed_t fixed_out[MAX_3D_AXIS_SIZE];
+  for (float x = 0; x < 40; x += 1.7f) {
+    for (float y = -10; y < 110; y += 6.1f) {
+      interpolate_table_threeaxis_layers_fixed(
+        &t, fixed_from_float(x), fixed_from_float(y), fixed_out);
+      for (int z = 0; z < 3; z++) {
+        float expected = interpolate_table_threeaxis_unchecked(&t, x, y, z);
+        ck_assert_float_eq_tol(fixed_to_float(fixed_out[z]), expected, 0.001);
+        ck_assert_int_eq(fixed_out[z],
+                         interpolate_table_threeaxis_fixed(&t,
+                                                           fixed_from_float(x),
+                                                           fixed_from_float(y),
+                                                           fixed_from_int(z)));
+      }
+    }
+  }
+#endif
+}
+END_TEST
+
+#ifdef FIXED_POINT_CALCULATIONS
+START_TEST(check_table_fixed_lookup) {
+  struct table_fixed fixed;
+  struct table t = t2;
+  t.fixed = &fixed;
+  ck_assert(table_valid(&t));
+  ck_assert_int_eq(fixed.bounds[1].min, fixed_from_int(-50));
+  ck_assert_int_eq(fixed.data.two[2][1], fixed_from_int(120));
+
+  for (float x = 0; x < 30; x += 0.7f) {
+    float y = -60 + 4.1f * x;
+    ck_assert_float_eq_tol(
+      fixed_to_float(interpolate_table_twoaxis_fixed(
+        &t, fixed_from_float(x), fixed_from_float(y))),
+      interpolate_table_twoaxis_unchecked(&t, x, y),
+      0.01);
+  }
+
+  struct table t1_valid = t1;
+  t1_valid.fixed = &fixed;
+  ck_assert(table_valid(&t1_valid));
+  for (float x = -10; x < 60; x += 0.9f) {
+    ck_assert_float_eq_tol(
+      fixed_to_float(
+        interpolate_table_oneaxis_fixed(&t1_valid, fixed_from_float(x))),
+      interpolate_table_oneaxis_unchecked(&t1_valid, x),
+      0.01);
+  }
+}
+END_TEST
+#endif
+
 TCase *setup_table_tests() {
   TCase *table_tests = tcase_create("tables");
   tcase_add_test(table_tests, check_table_oneaxis_interpolate);
   tcase_add_test(table_tests, check_table_oneaxis_clamp);
   tcase_add_test(table_tests, check_table_twoaxis_interpolate);
   tcase_add_test(table_tests, check_table_twoaxis_clamp);
+  tcase_add_test(table_tests, check_table_threeaxis_interpolate);
+  tcase_add_test(table_tests, check_table_threeaxis_clamp);
+  tcase_add_test(table_tests, check_table_valid);
+  tcase_add_test(table_tests, check_table_invalid_lookup);
+  tcase_add_test(table_tests, check_table_unchecked_lookup);
+  tcase_add_test(table_tests, check_table_twoaxis_batch);
+  tcase_add_test(table_tests, check_table_twoaxis_partial);
+  tcase_add_test(table_tests, check_table_threeaxis_layers);
+#ifdef FIXED_POINT_CALCULATIONS
+  tcase_add_test(table_tests, check_table_fixed_lookup);
+#endif
   return table_tests;
 }
 
@@ -3,7 +3,11 @@
 
 #include <stdint.h>
 
+#include "fixed.h"
+
 #define MAX_AXIS_SIZE 24
+/* Three axis tables share storage with two axis tables */
+#define MAX_3D_AXIS_SIZE 8
 
 struct table_axis {
   char name[32];
@@ -11,19 +15,110 @@ struct table_axis {
   float values[MAX_AXIS_SIZE];
 };
 
+/* Q16.16 copy of a table's axis, bounds and data for the fixed point lookups,
+ * kept up to date by table_valid(). It is held outside of the table so that
+ * it isn't part of the stored config */
+struct table_fixed {
+  fixed_t values[3][MAX_AXIS_SIZE];
+  struct {
+    fixed_t min;
+    fixed_t max;
+  } bounds[3];
+  union {
+    fixed_t one[MAX_AXIS_SIZE];
+    fixed_t two[MAX_AXIS_SIZE][MAX_AXIS_SIZE];
+    fixed_t three[MAX_3D_AXIS_SIZE][MAX_3D_AXIS_SIZE][MAX_3D_AXIS_SIZE];
+  } data;
+};
+
 struct table {
   char title[32];
   uint32_t num_axis;
-  struct table_axis axis[2];
+  struct table_axis axis[3];
   union {
     float one[MAX_AXIS_SIZE];
     float two[MAX_AXIS_SIZE][MAX_AXIS_SIZE];
+    float three[MAX_3D_AXIS_SIZE][MAX_3D_AXIS_SIZE][MAX_3D_AXIS_SIZE];
   } data;
+
+  /* Maintained by table_valid(), used by the unchecked lookups */
+  uint32_t valid;
+  struct {
+    float min;
+    float max;
+  } bounds[3];
+  /* Filled by table_valid() if set in a FIXED_POINT_CALCULATIONS build,
+   * required by the fixed point lookups */
+  struct table_fixed *fixed;
 };
 
 float interpolate_table_oneaxis(struct table *, float column);
 float interpolate_table_twoaxis(struct table *, float row, float column);
+float interpolate_table_threeaxis(struct table *,
+                                  float row,
+                                  float column,
+                                  float depth);
+
+/* Unchecked lookups skip validation and may only be used on tables that have
+ * passed table_valid() with the matching number of axis */
+float interpolate_table_oneaxis_unchecked(const struct table *, float column);
+float interpolate_table_twoaxis_unchecked(const struct table *,
+                                          float row,
+                                          float column);
+float interpolate_table_threeaxis_unchecked(const struct table *,
+                                            float row,
+                                            float column,
+                                            float depth);
+
+/* Evaluates a three axis table at the given row and column for each value of
+ * its third axis, without interpolating between them. The bins for the first
+ * two axis are found once and shared by all layers. Writes axis[2].num
+ * results, each the bilinear lookup of that layer */
+void interpolate_table_threeaxis_layers_unchecked(const struct table *,
+                                                  float row,
+                                                  float column,
+                                                  float *out);
+
+/* Fixed point versions of the unchecked lookups, which read the table's
+ * table_fixed copy rather than converting its contents */
+fixed_t interpolate_table_oneaxis_fixed(const struct table *, fixed_t column);
+fixed_t interpolate_table_twoaxis_fixed(const struct table *,
+                                        fixed_t row,
+                                        fixed_t column);
+fixed_t interpolate_table_threeaxis_fixed(const struct table *,
+                                          fixed_t row,
+                                          fixed_t column,
+                                          fixed_t depth);
+void interpolate_table_threeaxis_layers_fixed(const struct table *,
+                                              fixed_t row,
+                                              fixed_t column,
+                                              fixed_t *out);
+
+/* Splits an unchecked two axis lookup in two, for when the first input changes
+ * much less often than the second. The partial step interpolates along the
+ * first axis for every value of the second, storing axis[1].num results. The
+ * complete step finishes the lookup for the second input, giving identical
+ * results to interpolate_table_twoaxis_unchecked() */
+void interpolate_table_twoaxis_partial(const struct table *,
+                                       float row,
+                                       float *partial);
+float interpolate_table_twoaxis_complete(const struct table *,
+                                         const float *partial,
+                                         float column);
+fixed_t interpolate_table_twoaxis_complete_fixed(const struct table *,
+                                                 const fixed_t *partial,
+                                                 fixed_t column);
+
+/* Evaluates a two axis table at n points, writing each result to out. Gives
+ * identical results to interpolate_table_twoaxis() for each point */
+void interpolate_table_twoaxis_batch(struct table *,
+                                     const float *rows,
+                                     const float *columns,
+                                     float *out,
+                                     int n);
 
+/* Validates a table, updating its valid flag, cached axis bounds, and fixed
+ * point copy if FIXED_POINT_CALCULATIONS */
 int table_valid(struct table *);
 
 #ifdef UNITTEST
@@ -137,8 +137,23 @@ void handle_emergency_shutdown() {
   }
 }
 
+static void handle_slow_fueling() {
+  static timeval_t last_run = 0;
+
+  if (!config_is_valid()) {
+    return;
+  }
+
+  if (time_diff(current_time(), last_run) >=
+      time_from_us(config.calculations.slow_interval_us)) {
+    last_run = current_time();
+    calculate_slow_fueling();
+  }
+}
+
 void run_tasks() {
   stats_start_timing(STATS_TASK_TIME);
+  handle_slow_fueling();
   handle_fuel_pump();
   handle_boost_control();
   handle_idle_control();
@@ -5,24 +5,78 @@
 const float tick_degree_rpm_ratio = (TICKRATE / 6.0f);
 
 unsigned int rpm_from_time_diff(timeval_t t1, degrees_t deg) {
+#ifdef FIXED_POINT_CALCULATIONS
+  return rpm_from_time_diff_fixed(t1, fixed_from_float(deg));
+#else
   float ticks_per_degree = t1 / deg;
   unsigned int rpm = tick_degree_rpm_ratio / ticks_per_degree;
   return rpm;
+#endif
 }
 
 timeval_t time_from_rpm_diff(unsigned int rpm, degrees_t deg) {
+#ifdef FIXED_POINT_CALCULATIONS
+  return time_from_rpm_diff_fixed(rpm, fixed_from_float(deg));
+#else
   float ticks_per_degree = tick_degree_rpm_ratio / (float)rpm;
   return ticks_per_degree * deg;
+#endif
 }
 
 degrees_t degrees_from_time_diff(timeval_t t, unsigned int rpm) {
+#ifdef FIXED_POINT_CALCULATIONS
+  return fixed_to_float(degrees_from_time_diff_fixed(t, rpm));
+#else
   float ticks_per_degree = tick_degree_rpm_ratio / (float)rpm;
   return t / ticks_per_degree;
+#endif
 }
 
 timeval_t time_from_us(unsigned int us) {
+#ifdef FIXED_POINT_CALCULATIONS
+  return time_from_us_fixed(us);
+#else
   timeval_t ticks = us * (TICKRATE / 1000000.0f);
   return ticks;
+#endif
+}
+
+static uint64_t round_div_u64(uint64_t n, uint64_t d) {
+  return (n + d / 2) / d;
+}
+
+/* rpm = (TICKRATE / 6) * degrees / ticks */
+unsigned int rpm_from_time_diff_fixed(timeval_t t1, fixed_t deg) {
+  if (!t1 || (deg <= 0)) {
+    return 0;
+  }
+  return round_div_u64((uint64_t)TICKRATE * (uint32_t)deg,
+                       (uint64_t)6 * FIXED_ONE * t1);
+}
+
+/* ticks = (TICKRATE / 6) * degrees / rpm */
+timeval_t time_from_rpm_diff_fixed(unsigned int rpm, fixed_t deg) {
+  if (!rpm || (deg <= 0)) {
+    return 0;
+  }
+  return round_div_u64((uint64_t)TICKRATE * (uint32_t)deg,
+                       (uint64_t)6 * FIXED_ONE * rpm);
+}
+
+/* degrees = ticks * rpm * 6 / TICKRATE */
+fixed_t degrees_from_time_diff_fixed(timeval_t t, unsigned int rpm) {
+  uint64_t scaled = (uint64_t)t * rpm * 6;
+  /* Whole and fractional degrees are found separately to avoid overflow */
+  uint64_t whole = scaled / TICKRATE;
+  uint64_t frac = round_div_u64((scaled % TICKRATE) * FIXED_ONE, TICKRATE);
+  if (whole > FIXED_MAX / FIXED_ONE) {
+    return FIXED_MAX;
+  }
+  return fixed_saturate(whole * FIXED_ONE + frac);
+}
+
+timeval_t time_from_us_fixed(unsigned int us) {
+  return round_div_u64((uint64_t)us * TICKRATE, 1000000);
 }
 
 /* True if n is before x */
@@ -155,6 +209,28 @@ START_TEST(check_clamp_angle) {
 }
 END_TEST
 
+/* The integer conversions must agree with the float conversions to within
+ * their rounding */
+START_TEST(check_fixed_conversions_match_float) {
+  for (unsigned int rpm = 100; rpm < 10000; rpm += 77) {
+    for (degrees_t deg = 1; deg < 720; deg += 13.5f) {
+      fixed_t fdeg = fixed_from_float(deg);
+      timeval_t t = time_from_rpm_diff(rpm, deg);
+      ck_assert_float_eq_tol(time_from_rpm_diff_fixed(rpm, fdeg), t, 1);
+      ck_assert_float_eq_tol(
+        rpm_from_time_diff_fixed(t, fdeg), rpm_from_time_diff(t, deg), 1);
+      ck_assert_float_eq_tol(
+        fixed_to_float(degrees_from_time_diff_fixed(t, rpm)),
+        degrees_from_time_diff(t, rpm),
+        0.001);
+    }
+  }
+  for (unsigned int us = 0; us < 100000; us += 37) {
+    ck_assert_int_eq(time_from_us_fixed(us), time_from_us(us));
+  }
+}
+END_TEST
+
 TCase *setup_util_tests() {
   TCase *util_tests = tcase_create("util");
   tcase_add_test(util_tests, check_rpm_from_time_diff);
@@ -164,6 +240,7 @@ TCase *setup_util_tests() {
   tcase_add_test(util_tests, check_time_diff);
   tcase_add_test(util_tests, check_clamp_angle);
   tcase_add_test(util_tests, check_time_from_us);
+  tcase_add_test(util_tests, check_fixed_conversions_match_float);
   return util_tests;
 }
 
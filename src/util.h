@@ -1,8 +1,12 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include "fixed.h"
 #include "platform.h"
 
+/* Ticks per degree at 1 rpm */
+extern const float tick_degree_rpm_ratio;
+
 timeval_t time_diff(timeval_t t1, timeval_t t2);
 int time_before(timeval_t n, timeval_t x);
 timeval_t time_from_us(unsigned int us);
@@ -12,6 +16,13 @@ degrees_t degrees_from_time_diff(timeval_t, unsigned int);
 int time_in_range(timeval_t val, timeval_t t1, timeval_t t2);
 degrees_t clamp_angle(degrees_t, degrees_t);
 
+/* Integer versions of the above conversions, rounding to nearest. With
+ * FIXED_POINT_CALCULATIONS the float versions are implemented with these */
+unsigned int rpm_from_time_diff_fixed(timeval_t t1, fixed_t degrees);
+timeval_t time_from_rpm_diff_fixed(unsigned int rpm, fixed_t degrees);
+fixed_t degrees_from_time_diff_fixed(timeval_t, unsigned int rpm);
+timeval_t time_from_us_fixed(unsigned int us);
+
 #ifdef UNITTEST
 #include <check.h>
 TCase *setup_util_tests();
@@ -1,6 +1,7 @@
 #include "calculations.h"
 #include "config.h"
 #include "decoder.h"
+#include "knock.h"
 #include "platform.h"
 #include "scheduler.h"
 #include "sensors.h"
@@ -8,20 +9,35 @@
 #include "table.h"
 #include "tasks.h"
 #include "util.h"
-#include <assert.h>
 #include <stdio.h>
 
 int main() {
   platform_load_config();
+
+  /* Validating the config also populates the cached table parameters used by
+   * the unchecked table lookups. An invalid config leaves outputs disabled.
+   * Invalidating the calculations picks up the config's input epsilons */
+  config_valid();
+  calculations_invalidate();
+
+  sensors_reconfigure();
+  knock_reconfigure();
+
+  /* Fueling needs the slow terms before run_tasks() first computes them */
+  if (config_is_valid()) {
+    calculate_slow_fueling();
+  }
+
   decoder_init(&config.decoder);
   platform_init(0, NULL);
   initialize_scheduler();
 
-  assert(config_valid());
-
   sensors_process(SENSOR_CONST);
   while (1) {
     stats_increment_counter(STATS_MAINLOOP_RATE);
+    if (config.calculations.main_loop && config.decoder.valid) {
+      calculations_update_periodic();
+    }
     console_process();
   }
 
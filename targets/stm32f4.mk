@@ -15,6 +15,7 @@ CFLAGS+= -mfloat-abi=hard -mfpu=fpv4-sp-d16 -mthumb -mcpu=cortex-m4
 
 LDFLAGS+= -lc -lnosys -L ${OBJDIR} -l:${CM3_LIB} -Wl,--gc-sections
 LDFLAGS+= -T src/platforms/stm32f4-discovery.ld -nostartfiles
+LDFLAGS+= -Wl,--print-memory-usage
 
 ${OBJDIR}/libssp.a:
 	${AR} rcs ${OBJDIR}/libssp.a
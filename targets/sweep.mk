@@ -0,0 +1,7 @@
+OBJS+= sweep.o offline.o
+
+CFLAGS+= -O3 -DNDEBUG
+CFLAGS+= -D TICKRATE=4000000 -D_POSIX_C_SOURCE=199309L -D_DEFAULT_SOURCE
+
+sweep: ${OBJDIR}/viaems
+	${OBJDIR}/viaems